@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+// Histogram of batch sizes with one bucket per power of two
+class BatchSizeHistogram {
+public:
+  static constexpr size_t num_buckets = 33;
+
+  // bucket b holds the sizes in [2^b, 2^(b+1)). The last bucket also holds larger sizes
+  static inline size_t bucket(uint64_t size) {
+    size_t b = size == 0 ? 0 : 63 - __builtin_clzll(size);
+    return b < num_buckets ? b : num_buckets - 1;
+  }
+
+  inline void record(uint64_t size) { ++counts[bucket(size)]; }
+
+  void merge(const BatchSizeHistogram &oth);
+
+  uint64_t count(size_t b) const { return counts[b]; }
+  uint64_t total() const;
+
+  /**
+   * An upper bound on the given percentile of the batch sizes
+   * @param p  the percentile in [0, 1]
+   * @return the exclusive upper end of the bucket holding the percentile. 0 if empty.
+   */
+  uint64_t percentile(double p) const;
+
+private:
+  uint64_t counts[num_buckets] = {};
+};
+
+// A node tracked by HeavyHitters. Its true number of updates is in [count - error, count]
+struct HeavyHitter {
+  node_id_t node;
+  uint64_t count;
+  uint64_t error;
+};
+
+/**
+ * The space-saving summary (Metwally et al.) of the nodes receiving the most updates. Holds
+ * at most capacity counters. An untracked node replaces the counter with the smallest count,
+ * inheriting it as error. Every node receiving more than total/capacity updates is tracked.
+ * The counters form a min-heap by count so that recording takes O(log capacity) time.
+ */
+class HeavyHitters {
+public:
+  explicit HeavyHitters(size_t capacity = 1024) : capacity(capacity) {}
+
+  // record that node received weight updates
+  inline void record(node_id_t node, uint64_t weight) {
+    total += weight;
+    auto it = index.find(node);
+    if (it != index.end()) {
+      entries[it->second].count += weight;
+      sift_down(it->second);
+    }
+    else insert(node, weight);
+  }
+
+  /**
+   * Combine the summary of other updates into this one. A node missing from a full summary
+   * may have received up to its smallest count, so that is added to its count and error.
+   */
+  void merge(const HeavyHitters &oth);
+
+  // the k tracked nodes with the largest counts, largest first
+  std::vector<HeavyHitter> top(size_t k) const;
+
+  // the total weight recorded
+  uint64_t total_weight() const { return total; }
+
+private:
+  size_t capacity;
+  uint64_t total = 0;
+  std::vector<HeavyHitter> entries;             // a min-heap by count
+  std::unordered_map<node_id_t, size_t> index; // position of each tracked node in entries
+
+  void insert(node_id_t node, uint64_t weight);
+
+  // restore the heap property after the count at pos increased, or an entry was appended
+  void sift_down(size_t pos);
+  void sift_up(size_t pos);
+  void swap_entries(size_t a, size_t b);
+
+  // the smallest count if the summary is full, otherwise 0
+  uint64_t min_count() const;
+};
+
+// Batch statistics of the GraphWorkers
+struct WorkerBatchStats {
+  std::vector<BatchSizeHistogram> worker_batch_sizes; // the batch sizes of each GraphWorker
+  BatchSizeHistogram batch_sizes;                     // the batch sizes of every GraphWorker
+  HeavyHitters hot_nodes;                             // nodes receiving the most updates
+
+  friend std::ostream& operator<< (std::ostream &out, const WorkerBatchStats &stats);
+};
@@ -3,7 +3,20 @@
 #include <cstring>
 #include <unistd.h> //open and close
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#ifdef USE_IO_URING
+#include <cerrno>
+#include <liburing.h>
+#endif
 #include "graph.h"
+#include "binary_stream_format.h"
 
 class BadStreamException : public std::exception {
   virtual const char* what() const throw() {
@@ -17,6 +30,45 @@ class StreamFailedException : public std::exception {
   }
 };
 
+class StreamFormatException : public std::exception {
+  virtual const char* what() const throw() {
+    return "The stream file has an unknown format or one this stream class cannot read.";
+  }
+};
+
+// decode the binary encoded update at data
+static inline GraphUpdate decode_update(const char *data) {
+  uint32_t a;
+  uint32_t b;
+  std::memcpy(&a, data + 1, sizeof(uint32_t));
+  std::memcpy(&b, data + 5, sizeof(uint32_t));
+  return {{a,b}, (UpdateType) *data};
+}
+
+// decode the 8 byte update in the compact format at data. The compact header and updates
+// are multiples of 8 bytes and the readers' buffers are malloc'd, so data is always aligned.
+static inline GraphUpdate decode_compact_update(const char *data) {
+  const uint32_t *rec = (const uint32_t *) data;
+  return {{rec[0] & ~compact_type_bit, rec[1]}, (UpdateType) (rec[0] >> 31)};
+}
+
+// decode the update at data of a stream that is or is not in the compact format
+static inline GraphUpdate decode_update(const char *data, bool compact) {
+  return compact ? decode_compact_update(data) : decode_update(data);
+}
+
+// decode the num binary encoded updates beginning at data into upds
+static inline void decode_updates(const char *data, size_t num, GraphUpdate *upds,
+                                  bool compact) {
+  if (compact) {
+    for (size_t i = 0; i < num; i++)
+      upds[i] = decode_compact_update(data + i * compact_update_size);
+  } else {
+    for (size_t i = 0; i < num; i++)
+      upds[i] = decode_update(data + i * raw_update_size);
+  }
+}
+
 // A class for reading from a binary graph stream
 class BinaryGraphStream {
 public:
@@ -26,15 +78,27 @@ public:
     if (!bin_file.is_open()) {
       throw BadStreamException();
     }
+    // read header from the input file
+    char header_data[max_stream_header_size];
+    bin_file.read(header_data, max_stream_header_size);
+    if (!parse_stream_header(header_data, bin_file.gcount(), header))
+      throw StreamFormatException();
+    bin_file.clear();
+    bin_file.seekg(header.size);
+    num_nodes = header.num_nodes;
+    num_edges = header.num_upds;
+    edge_size = header.update_size();
+    compact   = header.format == COMPACT_FORMAT;
+
     // set the buffer size to be a multiple of an edge size and malloc memory
-    buf_size = _b - (_b % edge_size);
+    // a compressed stream is decoded one block at a time
+    if (header.format == COMPRESSED_FORMAT)
+      buf_size = header.block_upds * edge_size;
+    else
+      buf_size = _b - (_b % edge_size);
     buf = (char *) malloc(buf_size * sizeof(char));
     start_buf = buf;
 
-    // read header from the input file
-    bin_file.read(reinterpret_cast<char *>(&num_nodes), 4);
-    bin_file.read(reinterpret_cast<char *>(&num_edges), 8);
-    
     read_data(); // read in the first block of data
   }
   ~BinaryGraphStream() {
@@ -42,38 +106,83 @@ public:
   }
   inline uint32_t nodes() {return num_nodes;}
   inline uint64_t edges() {return num_edges;}
+  inline StreamFormat format() {return header.format;}
 
   inline GraphUpdate get_edge() {
-    UpdateType u = (UpdateType) *buf;
-    uint32_t a;
-    uint32_t b;
+    GraphUpdate upd = decode_update(buf, compact);
+    ++upds_read;
 
-    std::memcpy(&a, buf + 1, sizeof(uint32_t));
-    std::memcpy(&b, buf + 5, sizeof(uint32_t));
-    
     buf += edge_size;
     if (buf - start_buf == buf_size) read_data();
 
-    return {{a,b}, u};
+    return upd;
+  }
+
+  /*
+   * Decode the next updates of the stream into an array
+   * @param upds  the array to write the updates to
+   * @param num   the maximum number of updates to write
+   * @return      the number of updates written. Less than num only at the end of the stream
+   */
+  inline size_t get_edges(GraphUpdate *upds, size_t num) {
+    num = std::min(num, num_edges - upds_read);
+    size_t written = 0;
+    while (written < num) {
+      size_t in_buf = (buf_size - (buf - start_buf)) / edge_size;
+      size_t to_decode = std::min(in_buf, num - written);
+      decode_updates(buf, to_decode, upds + written, compact);
+      written += to_decode;
+
+      buf += to_decode * edge_size;
+      if (buf - start_buf == buf_size) read_data();
+    }
+    upds_read += num;
+    return num;
   }
 
 private:
   inline void read_data() {
     // set buf back to the beginning of the buffer read in data
     buf = start_buf;
+    if (header.format == COMPRESSED_FORMAT) {
+      read_compressed_block();
+      return;
+    }
     bin_file.read(buf, buf_size);
   
     if (bin_file.fail() && !bin_file.eof()) {
       throw StreamFailedException();
     }  
   }
-  const uint32_t edge_size = sizeof(uint8_t) + 2 * sizeof(uint32_t); // size of binary encoded edge
+
+  // read the next block of a compressed stream and decode it into buf
+  inline void read_compressed_block() {
+    if (blocks_read == header.num_blocks()) return;
+    uint32_t payload_size;
+    bin_file.read(reinterpret_cast<char *>(&payload_size), sizeof(payload_size));
+    payload.resize(payload_size);
+    bin_file.read(payload.data(), payload_size);
+    if (bin_file.fail()) throw StreamFailedException();
+
+    size_t block_upds = std::min((uint64_t) header.block_upds,
+                                 num_edges - blocks_read * header.block_upds);
+    if (!decompress_block(payload.data(), payload_size, block_upds, buf))
+      throw StreamFailedException();
+    ++blocks_read;
+  }
+
+  uint32_t edge_size;     // size of binary encoded edge
+  bool compact;           // are updates in the compact format
+  StreamHeader header;    // header of the stream file
+  std::vector<char> payload; // compressed block being decoded
+  uint64_t blocks_read = 0;  // number of compressed blocks read
   std::ifstream bin_file; // file to read from
   char *buf;              // data buffer
   char *start_buf;        // the start of the data buffer
   uint32_t buf_size;      // how big is the data buffer
   uint32_t num_nodes;     // number of nodes in the graph
   uint64_t num_edges;     // number of edges in the graph stream
+  uint64_t upds_read = 0; // number of updates returned so far
 };
 
 // Class for reading from a binary graph stream using many
@@ -82,23 +191,39 @@ class BinaryGraphStream_MT {
 public:
   BinaryGraphStream_MT(std::string file_name, uint32_t _b) {
     stream_fd = open(file_name.c_str(), O_RDONLY, S_IRUSR);
-    if (!stream_fd) {
+    if (stream_fd == -1) {
       throw BadStreamException();
     }
 
-    // set the buffer size to be a multiple of an edge size
-    buf_size = _b - (_b % edge_size);
-
     // read header from the input file
-    if (read(stream_fd, reinterpret_cast<char *>(&num_nodes), 4) != 4)
-      throw BadStreamException();
-    if (read(stream_fd, reinterpret_cast<char *>(&num_edges), 8) != 8)
+    char header_data[max_stream_header_size];
+    ssize_t header_read = pread(stream_fd, header_data, max_stream_header_size, 0);
+    if (header_read < (ssize_t) raw_header_size)
       throw BadStreamException();
+    if (!parse_stream_header(header_data, header_read, header))
+      throw StreamFormatException();
+    num_nodes   = header.num_nodes;
+    num_edges   = header.num_upds;
+    header_size = header.size;
+    edge_size   = header.update_size();
+    compact     = header.format == COMPACT_FORMAT;
+
+    // set the buffer size to be a multiple of an edge size
+    // readers claim whole blocks of a compressed stream
+    if (header.format == COMPRESSED_FORMAT) {
+      buf_size = header.block_upds * edge_size;
+      read_block_index();
+    }
+    else
+      buf_size = _b - (_b % edge_size);
+
+    // offsets into a compressed stream are those of the same update in a raw stream
     end_of_file = (num_edges * edge_size) + header_size;
     query_index = -1;
     stream_off = header_size;
     query_block = false;
   }
+  ~BinaryGraphStream_MT() { close(stream_fd); }
 
   /* Call this function to ask stream to pause so we can perform a query
    * This allows queries to be performed in the stream arbitrary at 32 KiB granularity
@@ -137,11 +262,15 @@ public:
   inline void stream_reset() {stream_off = header_size;}
   inline uint32_t nodes() {return num_nodes;}
   inline uint64_t edges() {return num_edges;}
+  inline StreamFormat format() {return header.format;}
   BinaryGraphStream_MT(const BinaryGraphStream_MT &) = delete;
   BinaryGraphStream_MT & operator=(const BinaryGraphStream_MT &) = delete;
   friend class MT_StreamReader;
-private:
+  friend class Async_StreamReader;
+protected:
   int stream_fd;
+  StreamHeader header;   // header of the stream file
+  std::vector<uint64_t> block_index; // file offsets of the blocks of a compressed stream
   uint32_t num_nodes;    // number of nodes in the graph
   uint64_t num_edges;    // number of edges in the graph stream
   uint32_t buf_size;     // how big is the data buffer
@@ -149,15 +278,32 @@ private:
   std::atomic<uint64_t> stream_off;  // where do threads read from in the stream
   std::atomic<uint64_t> query_index; // what is the index of the next query in bytes
   std::atomic<bool> query_block;     // If true block read_data calls and have thr return BREAKPOINT
-  const uint32_t edge_size = sizeof(uint8_t) + 2 * sizeof(uint32_t); // size of binary encoded edge
-  const size_t header_size = sizeof(node_id_t) + sizeof(edge_id_t); // size of num_nodes + num_upds
+  uint32_t edge_size;    // size of binary encoded edge
+  bool compact;          // are updates in the compact format
+  size_t header_size;    // size of the stream header
 
-  inline uint32_t read_data(char *buf) {
+  /*
+   * Claim the next block of the stream for a reader thread.
+   * @param read_off  set to the byte offset of the block within the stream file
+   * @return          the size of the block in bytes or 0 if blocked on a query or at EOF
+   */
+  inline uint32_t claim_block(uint64_t &read_off) {
     // we are blocking on a query or the stream is done so don't fetch_add or read
     if (query_block || stream_off >= end_of_file || stream_off >= query_index) return 0;
 
     // multiple threads may execute this line of code at once. This can cause edge cases
-    uint64_t read_off = stream_off.fetch_add(buf_size, std::memory_order_relaxed);
+    uint32_t claim_size = buf_size;
+    if (header.format == COMPRESSED_FORMAT) {
+      // claim up to the next block boundary so that no claim straddles two blocks. After a
+      // query splits a block the next claim takes the rest of it, realigning stream_off.
+      read_off = stream_off.load(std::memory_order_relaxed);
+      do {
+        claim_size = buf_size - (read_off - header_size) % buf_size;
+      } while (!stream_off.compare_exchange_weak(read_off, read_off + claim_size,
+                                                 std::memory_order_relaxed));
+    }
+    else
+      read_off = stream_off.fetch_add(buf_size, std::memory_order_relaxed);
 
     // we catch these edge cases using the two below checks
     if (read_off >= query_index) {
@@ -166,22 +312,105 @@ private:
     }
     if (read_off >= end_of_file) return 0;
     
-    // perform read using pread and ensure amount of data read is of appropriate size
-    size_t data_read = 0;
-    size_t data_to_read = buf_size;
-    if (query_index >= read_off && query_index < read_off + buf_size) {
+    size_t data_to_read = claim_size;
+    if (query_index >= read_off && query_index < read_off + claim_size) {
       data_to_read = query_index - read_off; // query truncates the read
       stream_off   = query_index.load();
     }
     if (read_off + data_to_read > end_of_file)
       data_to_read = end_of_file - read_off; // EOF truncates the read
+    return data_to_read;
+  }
 
-    while (data_read < data_to_read) {
-      int ret = pread(stream_fd, buf, data_to_read, read_off + data_read); // perform the read
-      if (ret == -1) throw StreamFailedException();
+  // read size bytes of the stream file at offset off into buf, retrying short reads
+  inline void pread_block(char *buf, uint64_t off, uint32_t size) {
+    size_t data_read = 0;
+    while (data_read < size) {
+      int ret = pread(stream_fd, buf + data_read, size - data_read,
+                      off + data_read); // perform the read
+      if (ret <= 0) throw StreamFailedException();
       data_read += ret;
     }
-    return data_read;
+  }
+
+  // load the index at the end of a compressed stream
+  void read_block_index() {
+    struct stat file_stat;
+    uint64_t index_size = (header.num_blocks() + 1) * sizeof(uint64_t);
+    if (fstat(stream_fd, &file_stat) == -1 || (uint64_t) file_stat.st_size < index_size)
+      throw BadStreamException();
+    block_index.resize(header.num_blocks() + 1);
+    pread_block((char *) block_index.data(), file_stat.st_size - index_size, index_size);
+    if (block_index.back() != file_stat.st_size - index_size) throw StreamFailedException();
+  }
+
+  // the compressed block holding the update at offset off, as if the stream were raw
+  inline uint64_t block_at(uint64_t off) const {
+    return (off - header_size) / edge_size / header.block_upds;
+  }
+
+  // the offset, as if the stream were raw, of the first update of a compressed block
+  inline uint64_t block_start(uint64_t block) const {
+    return header_size + block * header.block_upds * edge_size;
+  }
+
+  inline uint64_t upds_in_block(uint64_t block) const {
+    return std::min((uint64_t) header.block_upds, num_edges - block * header.block_upds);
+  }
+
+  // the file offset and size of the payload of a compressed block
+  inline uint64_t payload_off(uint64_t block) const {
+    return block_index[block] + sizeof(uint32_t);
+  }
+  inline uint32_t payload_size(uint64_t block) const {
+    return block_index[block + 1] - payload_off(block);
+  }
+
+  /*
+   * Read the updates of a compressed stream in the range claimed by claim_block and
+   * decode them into buf.
+   * @param buf       where to write the decoded updates
+   * @param read_off  the offset of the first update as if the stream were raw
+   * @param size      the size of the range in bytes as if the stream were raw
+   * @param scratch   space to read compressed blocks into
+   */
+  inline void read_compressed(char *buf, uint64_t read_off, uint32_t size,
+                              std::vector<char> &scratch) {
+    uint64_t first_upd = (read_off - header_size) / edge_size;
+    uint64_t num_upds  = size / edge_size;
+    // a range lies within a single block and is the whole block unless it borders a query
+    for (uint64_t upd = first_upd; upd < first_upd + num_upds;) {
+      uint64_t block      = upd / header.block_upds;
+      uint64_t block_upds = upds_in_block(block);
+      uint64_t skip       = upd - block * header.block_upds;
+      uint64_t take       = std::min(block_upds - skip, first_upd + num_upds - upd);
+
+      uint32_t size = payload_size(block);
+      bool whole_block = skip == 0 && take == block_upds;
+      scratch.resize(size + (whole_block ? 0 : block_upds * edge_size));
+      pread_block(scratch.data(), payload_off(block), size);
+
+      char *dst = buf + (upd - first_upd) * edge_size;
+      char *decoded = whole_block ? dst : scratch.data() + size;
+      if (!decompress_block(scratch.data(), size, block_upds, decoded))
+        throw StreamFailedException();
+      if (!whole_block)
+        std::memcpy(dst, decoded + skip * edge_size, take * edge_size);
+      upd += take;
+    }
+  }
+
+  inline uint32_t read_data(char *buf, std::vector<char> &scratch) {
+    uint64_t read_off;
+    uint32_t data_to_read = claim_block(read_off);
+    if (data_to_read == 0) return 0;
+
+    // perform read using pread and ensure amount of data read is of appropriate size
+    if (header.format == COMPRESSED_FORMAT)
+      read_compressed(buf, read_off, data_to_read, scratch);
+    else
+      pread_block(buf, read_off, data_to_read);
+    return data_to_read;
   }
 };
 
@@ -197,22 +426,33 @@ public:
   inline GraphUpdate get_edge() {
     // if we have read all the data in the buffer than refill it
     if (buf - start_buf >= data_in_buf) {
-      if ((data_in_buf = stream.read_data(start_buf)) == 0) {
+      if ((data_in_buf = stream.read_data(start_buf, scratch)) == 0) {
         return {{0, 0}, BREAKPOINT}; // return that a break point has been reached
       }
       buf = start_buf; // point buf back to beginning of data buffer
     }
 
-    UpdateType u = (UpdateType) *buf;
-    uint32_t a;
-    uint32_t b;
-
-    std::memcpy(&a, buf + 1, sizeof(uint32_t));
-    std::memcpy(&b, buf + 5, sizeof(uint32_t));
-    
+    GraphUpdate upd = decode_update(buf, stream.compact);
     buf += stream.edge_size;
+    return upd;
+  }
 
-    return {{a,b}, u};
+  /*
+   * Decode the next updates in this reader's block of the stream into an array, claiming
+   * a new block if this one is empty
+   * @param upds  the array to write the updates to
+   * @param num   the maximum number of updates to write
+   * @return      the number of updates written or 0 if a break point has been reached
+   */
+  inline size_t get_edges(GraphUpdate *upds, size_t num) {
+    if (buf - start_buf >= data_in_buf) {
+      if ((data_in_buf = stream.read_data(start_buf, scratch)) == 0) return 0;
+      buf = start_buf;
+    }
+    num = std::min(num, (size_t) (start_buf + data_in_buf - buf) / stream.edge_size);
+    decode_updates(buf, num, upds, stream.compact);
+    buf += num * stream.edge_size;
+    return num;
   }
 
 private:
@@ -220,4 +460,353 @@ private:
   char *buf;                    // data buffer
   char *start_buf;              // the start of the data buffer
   uint32_t data_in_buf = 0;     // amount of data in data buffer
+  std::vector<char> scratch;    // compressed blocks are read here
+};
+
+// Class for reading from a binary graph stream by mapping it into memory. Many
+// MMap_StreamReader threads claim blocks of the stream in the same way as
+// BinaryGraphStream_MT but decode updates directly from the mapping without copying.
+// Supports the same query interface as BinaryGraphStream_MT. Cannot read compressed streams.
+class MMapGraphStream : public BinaryGraphStream_MT {
+public:
+  MMapGraphStream(std::string file_name, uint32_t _b) : BinaryGraphStream_MT(file_name, _b) {
+    if (header.format == COMPRESSED_FORMAT) throw StreamFormatException();
+    struct stat file_stat;
+    if (fstat(stream_fd, &file_stat) == -1 || (uint64_t) file_stat.st_size < end_of_file)
+      throw BadStreamException();
+
+    map = (char *) mmap(nullptr, end_of_file, PROT_READ, MAP_PRIVATE, stream_fd, 0);
+    if (map == MAP_FAILED) throw BadStreamException();
+    madvise(map, end_of_file, MADV_SEQUENTIAL);
+    advise_readahead(0);
+  }
+  ~MMapGraphStream() { munmap(map, end_of_file); }
+
+  MMapGraphStream(const MMapGraphStream &) = delete;
+  MMapGraphStream & operator=(const MMapGraphStream &) = delete;
+  friend class MMap_StreamReader;
+private:
+  char *map;                          // the mapping of the stream file
+  std::atomic<uint64_t> advised_end{0}; // end of the region we've asked the kernel to read
+  static constexpr uint64_t readahead = 32 * 1024 * 1024; // size of each readahead request
+
+  // ask the kernel to read the next window of the stream once readers reach off
+  inline void advise_readahead(uint64_t off) {
+    uint64_t end = advised_end.load(std::memory_order_relaxed);
+    if (off + readahead / 2 < end || end >= end_of_file) return;
+    if (!advised_end.compare_exchange_strong(end, end + readahead)) return;
+
+    uint64_t len = std::min(readahead, end_of_file - end);
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t aligned = end - end % page;
+    madvise(map + aligned, len + (end - aligned), MADV_WILLNEED);
+  }
+
+  // claim the next block of the stream. Returns its size and points data at it.
+  inline uint32_t map_data(const char *&data) {
+    uint64_t read_off;
+    uint32_t data_to_read = claim_block(read_off);
+    if (data_to_read == 0) return 0;
+    advise_readahead(read_off);
+    data = map + read_off;
+    return data_to_read;
+  }
+};
+
+// this class provides an interface for interacting with the
+// MMapGraphStream from a single thread
+class MMap_StreamReader {
+public:
+  MMap_StreamReader(MMapGraphStream &stream) : stream(stream) {}
+
+  inline GraphUpdate get_edge() {
+    // if we have decoded all the data in the block than claim another
+    if (buf == end_buf) {
+      uint32_t data_in_block = stream.map_data(buf);
+      if (data_in_block == 0) {
+        return {{0, 0}, BREAKPOINT}; // return that a break point has been reached
+      }
+      end_buf = buf + data_in_block;
+    }
+
+    GraphUpdate upd = decode_update(buf, stream.compact);
+    buf += stream.edge_size;
+    return upd;
+  }
+
+  // Decode up to num updates into upds. Same semantics as MT_StreamReader::get_edges
+  inline size_t get_edges(GraphUpdate *upds, size_t num) {
+    if (buf == end_buf) {
+      uint32_t data_in_block = stream.map_data(buf);
+      if (data_in_block == 0) return 0;
+      end_buf = buf + data_in_block;
+    }
+    num = std::min(num, (size_t) (end_buf - buf) / stream.edge_size);
+    decode_updates(buf, num, upds, stream.compact);
+    buf += num * stream.edge_size;
+    return num;
+  }
+
+private:
+  MMapGraphStream &stream;       // stream to pull data from
+  const char *buf = nullptr;     // the next update within the mapping
+  const char *end_buf = nullptr; // the end of the block claimed by this reader
+};
+
+// Class for reading from a binary graph stream with asynchronous reads. Each
+// Async_StreamReader keeps queue_depth blocks of the stream in flight so that disk reads
+// overlap with the processing of updates. Reads are issued with io_uring when built with
+// USE_IO_URING and otherwise by a pool of io_threads threads owned by the stream. Readers
+// that cannot set up an io_uring at runtime also fall back to the pool.
+// Supports the same query interface as BinaryGraphStream_MT. The payloads of compressed
+// blocks are read asynchronously and decoded by the reader once they arrive.
+class AsyncGraphStream : public BinaryGraphStream_MT {
+public:
+  AsyncGraphStream(std::string file_name, uint32_t _b, size_t queue_depth = 4,
+                   size_t io_threads = 4) :
+    BinaryGraphStream_MT(file_name, _b), queue_depth(std::max(queue_depth, (size_t) 1)),
+    num_io_threads(std::max(io_threads, (size_t) 1)) {
+#ifndef USE_IO_URING
+    start_io_workers();
+#endif
+  }
+  ~AsyncGraphStream() {
+    {
+      std::lock_guard<std::mutex> lk(request_lock);
+      shutdown = true;
+    }
+    request_cv.notify_all();
+    for (auto &worker : io_workers) worker.join();
+  }
+
+  AsyncGraphStream(const AsyncGraphStream &) = delete;
+  AsyncGraphStream & operator=(const AsyncGraphStream &) = delete;
+  friend class Async_StreamReader;
+private:
+  const size_t queue_depth;    // number of blocks each reader keeps in flight
+  const size_t num_io_threads; // size of the pool of io_workers
+
+  std::vector<std::thread> io_workers;               // threads performing the reads
+  std::once_flag io_workers_started;
+  std::deque<std::packaged_task<void()>> requests;   // reads waiting for an io_worker
+  std::mutex request_lock;
+  std::condition_variable request_cv;
+  bool shutdown = false;
+
+  // start the pool of io_workers. With io_uring this is only done once a reader cannot set
+  // up its ring.
+  void start_io_workers() {
+    std::call_once(io_workers_started, [this]() {
+      io_workers.reserve(num_io_threads);
+      for (size_t t = 0; t < num_io_threads; t++)
+        io_workers.emplace_back(&AsyncGraphStream::io_worker, this);
+    });
+  }
+
+  // queue a read of the stream and return a future that is ready once it completes
+  inline std::future<void> submit_read(char *buf, uint64_t off, uint32_t size) {
+    std::packaged_task<void()> read([this, buf, off, size]() { pread_block(buf, off, size); });
+    std::future<void> ret = read.get_future();
+    {
+      std::lock_guard<std::mutex> lk(request_lock);
+      requests.push_back(std::move(read));
+    }
+    request_cv.notify_one();
+    return ret;
+  }
+
+  void io_worker() {
+    while (true) {
+      std::packaged_task<void()> read;
+      {
+        std::unique_lock<std::mutex> lk(request_lock);
+        request_cv.wait(lk, [this]() { return shutdown || !requests.empty(); });
+        if (requests.empty()) return; // shutdown and no more work to do
+        read = std::move(requests.front());
+        requests.pop_front();
+      }
+      read(); // exceptions are delivered to the reader through the future
+    }
+  }
+};
+
+// this class provides an interface for interacting with the
+// AsyncGraphStream from a single thread
+class Async_StreamReader {
+public:
+  Async_StreamReader(AsyncGraphStream &stream) : stream(stream), blocks(stream.queue_depth) {
+    for (auto &block : blocks) block.buf = (char *) malloc(stream.buf_size * sizeof(char));
+#ifdef USE_IO_URING
+    // io_uring may be disabled or limited by the kernel, so fall back to the io_workers
+    use_uring = io_uring_queue_init(stream.queue_depth, &ring, 0) >= 0;
+    if (!use_uring) {
+      static std::once_flag warned;
+      std::call_once(warned, []() {
+        std::cerr << "WARNING: could not set up io_uring, reading the stream with a pool of "
+                     "I/O threads" << std::endl;
+      });
+      stream.start_io_workers();
+    }
+#endif
+  }
+
+  ~Async_StreamReader() {
+    // the buffers of blocks that are still being read cannot be freed
+    for (size_t i = decoding ? 1 : 0; i < in_flight; i++) {
+      try {
+        wait_block(blocks[(head + i) % blocks.size()]);
+      } catch (...) {}
+    }
+#ifdef USE_IO_URING
+    if (use_uring) io_uring_queue_exit(&ring);
+#endif
+    for (auto &block : blocks) free(block.buf);
+  }
+
+  inline GraphUpdate get_edge() {
+    // if we have decoded all the data in the current block than move to the next one
+    if (buf == end_buf && !next_block()) {
+      return {{0, 0}, BREAKPOINT}; // return that a break point has been reached
+    }
+
+    GraphUpdate upd = decode_update(buf, stream.compact);
+    buf += stream.edge_size;
+    return upd;
+  }
+
+  // Decode up to num updates into upds. Same semantics as MT_StreamReader::get_edges
+  inline size_t get_edges(GraphUpdate *upds, size_t num) {
+    if (buf == end_buf && !next_block()) return 0;
+    num = std::min(num, (size_t) (end_buf - buf) / stream.edge_size);
+    decode_updates(buf, num, upds, stream.compact);
+    buf += num * stream.edge_size;
+    return num;
+  }
+
+  Async_StreamReader(const Async_StreamReader &) = delete;
+  Async_StreamReader & operator=(const Async_StreamReader &) = delete;
+private:
+  struct StreamBlock {
+    char *buf;     // buffer the updates of the block are read or decoded into
+    uint64_t off;  // offset of the block within the stream file, as if the stream were raw
+    uint32_t size; // size of the block in bytes, as if the stream were raw
+    std::vector<char> payload; // payload of the compressed block holding this block
+    char *read_buf;     // where the read of the block is placed
+    uint64_t read_off;  // file offset of the read
+    uint32_t read_size; // size of the read in bytes
+#ifdef USE_IO_URING
+    int result;    // result of the io_uring read
+    bool done;     // has the io_uring read completed
+#endif
+    std::future<void> read; // ready once the io_worker has read the block
+  };
+
+  AsyncGraphStream &stream;        // stream to pull data from
+  std::vector<StreamBlock> blocks; // ring of blocks, blocks[head] is the oldest
+  size_t head = 0;                 // the block being decoded or waited on
+  size_t in_flight = 0;            // number of blocks starting at head that have been claimed
+  bool decoding = false;           // is blocks[head] the block being decoded
+  bool blocked = false;            // did the stream refuse to give us another block
+  const char *buf = nullptr;       // the next update within blocks[head]
+  const char *end_buf = nullptr;   // the end of the data in blocks[head]
+#ifdef USE_IO_URING
+  struct io_uring ring;
+  bool use_uring; // was the ring set up or are reads issued to the io_workers
+#endif
+
+  // claim blocks of the stream and start reading them until the queue is full. Once the
+  // stream returns no block we stop asking until the blocks we have are drained.
+  inline void fill_queue() {
+    while (!blocked && in_flight < blocks.size()) {
+      StreamBlock &block = blocks[(head + in_flight) % blocks.size()];
+      block.size = stream.claim_block(block.off);
+      if (block.size == 0) {
+        blocked = true;
+        break;
+      }
+      if (stream.header.format == COMPRESSED_FORMAT) {
+        // a claim lies within one compressed block, so read its whole payload
+        uint64_t comp_block = stream.block_at(block.off);
+        block.payload.resize(stream.payload_size(comp_block));
+        block.read_buf  = block.payload.data();
+        block.read_off  = stream.payload_off(comp_block);
+        block.read_size = block.payload.size();
+      } else {
+        block.read_buf  = block.buf;
+        block.read_off  = block.off;
+        block.read_size = block.size;
+      }
+      issue_block(block);
+      ++in_flight;
+    }
+#ifdef USE_IO_URING
+    if (use_uring) io_uring_submit(&ring);
+#endif
+  }
+
+  // advance to the next block of updates. Returns false if we have reached a BREAKPOINT.
+  inline bool next_block() {
+    if (decoding) {
+      // we are done with the block at head so its buffer can be reused
+      head = (head + 1) % blocks.size();
+      --in_flight;
+      decoding = false;
+    }
+    fill_queue();
+    if (in_flight == 0) {
+      blocked = false; // resume claiming blocks upon the next call to get_edge
+      return false;
+    }
+    decoding = true;
+    StreamBlock &block = blocks[head];
+    wait_block(block);
+    buf = block.buf;
+    if (stream.header.format == COMPRESSED_FORMAT) {
+      // decode the whole compressed block then skip to the claimed updates
+      uint64_t comp_block = stream.block_at(block.off);
+      if (!decompress_block(block.payload.data(), block.payload.size(),
+                            stream.upds_in_block(comp_block), block.buf))
+        throw StreamFailedException();
+      buf += block.off - stream.block_start(comp_block);
+    }
+    end_buf = buf + block.size;
+    return true;
+  }
+
+#ifdef USE_IO_URING
+  inline void issue_block(StreamBlock &block) {
+    if (!use_uring) return issue_pool_read(block);
+    block.done = false;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, stream.stream_fd, block.read_buf, block.read_size, block.read_off);
+    io_uring_sqe_set_data(sqe, &block);
+  }
+
+  // reap completions until the read of block is done
+  inline void wait_block(StreamBlock &block) {
+    if (!use_uring) return block.read.get();
+    while (!block.done) {
+      struct io_uring_cqe *cqe;
+      int ret = io_uring_wait_cqe(&ring, &cqe);
+      if (ret == -EINTR) continue;
+      if (ret < 0) throw StreamFailedException();
+      StreamBlock *completed = (StreamBlock *) io_uring_cqe_get_data(cqe);
+      completed->result = cqe->res;
+      completed->done = true;
+      io_uring_cqe_seen(&ring, cqe);
+    }
+    if (block.result < 0) throw StreamFailedException();
+    if ((uint32_t) block.result < block.read_size) // finish a short read synchronously
+      stream.pread_block(block.read_buf + block.result, block.read_off + block.result,
+                         block.read_size - block.result);
+  }
+#else
+  inline void issue_block(StreamBlock &block) { issue_pool_read(block); }
+
+  inline void wait_block(StreamBlock &block) { block.read.get(); }
+#endif
+
+  inline void issue_pool_read(StreamBlock &block) {
+    block.read = stream.submit_read(block.read_buf, block.read_off, block.read_size);
+  }
 };
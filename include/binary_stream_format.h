@@ -0,0 +1,288 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include <graph_zeppelin_common.h>
+
+/*
+ * Binary graph streams begin with one of two headers.
+ * Unversioned (raw) streams:
+ *   <num_nodes> <num_updates>                               followed by 9 byte updates
+ *   | 4 bytes  |   8 bytes   |
+ * Versioned streams:
+ *   <marker> <version> <num_nodes> <num_updates> <format specific fields>
+ *   |4 bytes| 4 bytes |  4 bytes  |   8 bytes   |
+ * where marker is stream_format_marker, a value that no valid num_nodes can take.
+ */
+static constexpr uint32_t stream_format_marker = 0xFFFFFFFF;
+static constexpr size_t raw_header_size        = sizeof(node_id_t) + sizeof(edge_id_t);
+static constexpr size_t versioned_header_size  = 2 * sizeof(uint32_t) + raw_header_size;
+static constexpr size_t max_stream_header_size = 24;
+static constexpr size_t raw_update_size        = sizeof(uint8_t) + 2 * sizeof(node_id_t);
+static constexpr size_t compact_update_size    = 2 * sizeof(node_id_t);
+static constexpr size_t compact_header_size    = max_stream_header_size;
+static_assert(compact_header_size % compact_update_size == 0,
+              "compact updates must be aligned within the stream file");
+static constexpr uint32_t compact_type_bit     = 1u << 31;
+
+// the most updates in a block of a compressed stream. Readers buffer a decoded block and
+// its size in bytes must fit in 32 bits.
+static constexpr uint32_t max_block_upds = 1u << 24;
+
+enum StreamFormat : uint32_t {
+  RAW_FORMAT        = 0, // unversioned stream of 9 byte updates
+  COMPRESSED_FORMAT = 1, // blocks of delta-varint encoded updates
+  COMPACT_FORMAT    = 2, // 8 byte updates with the update type in the high bit of src
+};
+
+/*
+ * The compact format has one format specific header field <reserved | 4 bytes>, which must
+ * be zero. It pads the header to compact_header_size bytes so that every update is 8 byte
+ * aligned within the file. Each update is
+ *   <src | type << 31> <dst>
+ *   |     4 bytes    | 4 bytes |
+ * so node ids must fit in 31 bits.
+ */
+
+/*
+ * The compressed format has one format specific header field <block_upds | 4 bytes>, the
+ * number of updates in every block but the last. Following the header are the blocks
+ *   <payload_size> <payload>
+ *   |  4 bytes   | payload_size bytes |
+ * and the stream ends with an index giving the file offset of each block followed by the
+ * offset of the index itself
+ *   <block_off> ... <block_off> <index_off>
+ *   |  8 bytes | ... | 8 bytes  |  8 bytes  |
+ * Within a payload each update is two varints: the zigzag encoded difference between its
+ * src and the src of the previous update in the block shifted left by one with the update
+ * type in the low bit, then the zigzag encoded difference between its dst and src.
+ * Blocks can therefore be decoded independently of one another.
+ */
+struct StreamHeader {
+  StreamFormat format  = RAW_FORMAT;
+  node_id_t num_nodes  = 0;
+  edge_id_t num_upds   = 0;
+  uint32_t block_upds  = 0;  // updates per block of a compressed stream
+  size_t size          = raw_header_size; // size of the header in bytes
+
+  // size of an update as read from the stream. Compressed streams are decoded to raw updates.
+  inline size_t update_size() const {
+    return format == COMPACT_FORMAT ? compact_update_size : raw_update_size;
+  }
+
+  inline uint64_t num_blocks() const {
+    return format == COMPRESSED_FORMAT ? (num_upds + block_upds - 1) / block_upds : 0;
+  }
+};
+
+/*
+ * Parse the header at the beginning of a stream
+ * @param data    the beginning of the stream
+ * @param len     the number of bytes at data. Need not be more than max_stream_header_size
+ * @param header  filled with the parsed header
+ * @return        false if the header is truncated, of an unknown version, or invalid
+ */
+static inline bool parse_stream_header(const char *data, size_t len, StreamHeader &header) {
+  if (len < raw_header_size) return false;
+  uint32_t first;
+  std::memcpy(&first, data, sizeof(first));
+  if (first != stream_format_marker) {
+    header = StreamHeader();
+    header.num_nodes = first;
+    std::memcpy(&header.num_upds, data + 4, sizeof(header.num_upds));
+    return true;
+  }
+
+  if (len < versioned_header_size) return false;
+  uint32_t version;
+  std::memcpy(&version, data + 4, sizeof(version));
+  header = StreamHeader();
+  std::memcpy(&header.num_nodes, data + 8, sizeof(header.num_nodes));
+  std::memcpy(&header.num_upds, data + 12, sizeof(header.num_upds));
+  header.size = versioned_header_size;
+  switch (version) {
+    case COMPRESSED_FORMAT:
+      if (len < max_stream_header_size) return false;
+      header.format = COMPRESSED_FORMAT;
+      std::memcpy(&header.block_upds, data + versioned_header_size, sizeof(header.block_upds));
+      header.size = max_stream_header_size;
+      return header.block_upds > 0 && header.block_upds <= max_block_upds;
+    case COMPACT_FORMAT: {
+      if (len < compact_header_size) return false;
+      uint32_t reserved;
+      std::memcpy(&reserved, data + versioned_header_size, sizeof(reserved));
+      header.format = COMPACT_FORMAT;
+      header.size = compact_header_size;
+      return reserved == 0 && header.num_nodes <= compact_type_bit;
+    }
+    default:
+      return false;
+  }
+}
+
+static inline void write_stream_header(std::ostream &out, const StreamHeader &header) {
+  if (header.format != RAW_FORMAT) {
+    uint32_t version = header.format;
+    out.write((const char *) &stream_format_marker, sizeof(stream_format_marker));
+    out.write((const char *) &version, sizeof(version));
+  }
+  out.write((const char *) &header.num_nodes, sizeof(header.num_nodes));
+  out.write((const char *) &header.num_upds, sizeof(header.num_upds));
+  if (header.format == COMPRESSED_FORMAT)
+    out.write((const char *) &header.block_upds, sizeof(header.block_upds));
+  if (header.format == COMPACT_FORMAT) {
+    uint32_t reserved = 0;
+    out.write((const char *) &reserved, sizeof(reserved));
+  }
+}
+
+// encode an update as raw_update_size bytes at out
+static inline void encode_raw_update(char *out, uint8_t type, node_id_t src, node_id_t dst) {
+  *out = type;
+  std::memcpy(out + 1, &src, sizeof(src));
+  std::memcpy(out + 5, &dst, sizeof(dst));
+}
+
+// encode an update in the compact format at out. src and dst must be less than 2^31.
+static inline void encode_compact_update(char *out, uint8_t type, node_id_t src,
+                                         node_id_t dst) {
+  uint32_t rec[2] = {src | (type ? compact_type_bit : 0), dst};
+  std::memcpy(out, rec, sizeof(rec));
+}
+
+// write an update in the compact format. src and dst must be less than 2^31.
+static inline void write_compact_update(std::ostream &out, uint8_t type, node_id_t src,
+                                        node_id_t dst) {
+  char rec[compact_update_size];
+  encode_compact_update(rec, type, src, dst);
+  out.write(rec, sizeof(rec));
+}
+
+// number of updates per block written by default. Decodes to 36 KiB of raw updates.
+static constexpr uint32_t default_block_upds = 4096;
+
+// the largest payload that num updates can compress to
+static inline size_t max_compressed_size(size_t num) { return num * 2 * 10; }
+
+static inline char *encode_varint(uint64_t val, char *out) {
+  while (val >= 0x80) {
+    *out++ = (char) (val | 0x80);
+    val >>= 7;
+  }
+  *out++ = (char) val;
+  return out;
+}
+
+// returns nullptr if the varint runs past end
+static inline const char *decode_varint(const char *in, const char *end, uint64_t &val) {
+  val = 0;
+  for (int shift = 0; in < end && shift < 64; shift += 7) {
+    uint8_t byte = *in++;
+    val |= (uint64_t) (byte & 0x7F) << shift;
+    if (byte < 0x80) return in;
+  }
+  return nullptr;
+}
+
+static inline uint64_t zigzag_encode(int64_t val) { return ((uint64_t) val << 1) ^ (val >> 63); }
+static inline int64_t zigzag_decode(uint64_t val) { return (val >> 1) ^ -(int64_t) (val & 1); }
+
+/*
+ * Compress a block of raw 9 byte updates
+ * @param raw  the updates to compress
+ * @param num  the number of updates
+ * @param out  where to write the payload. Must have room for max_compressed_size(num) bytes
+ * @return     the size of the payload in bytes
+ */
+static inline size_t compress_block(const char *raw, size_t num, char *out) {
+  char *pos = out;
+  uint32_t prev_src = 0;
+  for (size_t i = 0; i < num; i++, raw += raw_update_size) {
+    uint32_t src, dst;
+    std::memcpy(&src, raw + 1, sizeof(src));
+    std::memcpy(&dst, raw + 5, sizeof(dst));
+    pos = encode_varint(zigzag_encode((int64_t) src - prev_src) << 1 | (*raw & 1), pos);
+    pos = encode_varint(zigzag_encode((int64_t) dst - src), pos);
+    prev_src = src;
+  }
+  return pos - out;
+}
+
+/*
+ * Decompress a payload into raw 9 byte updates
+ * @param in   the payload
+ * @param len  the size of the payload in bytes
+ * @param num  the number of updates in the block
+ * @param raw  where to write the updates. Must have room for num updates
+ * @return     false if the payload does not hold exactly num updates
+ */
+static inline bool decompress_block(const char *in, size_t len, size_t num, char *raw) {
+  const char *end = in + len;
+  uint32_t src = 0;
+  for (size_t i = 0; i < num; i++, raw += raw_update_size) {
+    uint64_t src_code, dst_code;
+    if ((in = decode_varint(in, end, src_code)) == nullptr) return false;
+    if ((in = decode_varint(in, end, dst_code)) == nullptr) return false;
+    src += (uint32_t) zigzag_decode(src_code >> 1);
+    uint32_t dst = src + (uint32_t) zigzag_decode(dst_code);
+    *raw = src_code & 1;
+    std::memcpy(raw + 1, &src, sizeof(src));
+    std::memcpy(raw + 5, &dst, sizeof(dst));
+  }
+  return in == end;
+}
+
+// Writes a stream in the compressed format one update at a time
+class CompressedStreamWriter {
+public:
+  CompressedStreamWriter(std::ostream &out, node_id_t num_nodes, edge_id_t num_upds,
+                         uint32_t block_upds = default_block_upds) :
+    out(out), raw((size_t) block_upds * raw_update_size),
+    payload(max_compressed_size(block_upds)) {
+    if (block_upds == 0 || block_upds > max_block_upds)
+      throw std::invalid_argument("block_upds must be in [1, max_block_upds]");
+    header.format     = COMPRESSED_FORMAT;
+    header.num_nodes  = num_nodes;
+    header.num_upds   = num_upds;
+    header.block_upds = block_upds;
+    header.size       = max_stream_header_size;
+    write_stream_header(out, header);
+    block_offs.reserve(header.num_blocks() + 1);
+  }
+
+  // add the next update to the stream. Exactly num_upds updates must be written.
+  inline void write(uint8_t type, node_id_t src, node_id_t dst) {
+    encode_raw_update(raw.data() + in_block * raw_update_size, type, src, dst);
+    if (++in_block == header.block_upds) write_block();
+  }
+
+  // write the final block and the index
+  void finish() {
+    if (in_block > 0) write_block();
+    block_offs.push_back(header.size + bytes_written);
+    out.write((const char *) block_offs.data(), block_offs.size() * sizeof(uint64_t));
+  }
+
+  // total bytes of the stream excluding the header and index
+  inline uint64_t blocks_size() const { return bytes_written; }
+
+private:
+  std::ostream &out;
+  StreamHeader header;
+  std::vector<char> raw;             // raw updates of the block being filled
+  std::vector<char> payload;         // compressed block
+  std::vector<uint64_t> block_offs;  // file offset of each block
+  uint32_t in_block = 0;             // number of updates in the block being filled
+  uint64_t bytes_written = 0;
+
+  void write_block() {
+    uint32_t payload_size = compress_block(raw.data(), in_block, payload.data());
+    block_offs.push_back(header.size + bytes_written);
+    out.write((const char *) &payload_size, sizeof(payload_size));
+    out.write(payload.data(), payload_size);
+    bytes_written += sizeof(payload_size) + payload_size;
+    in_block = 0;
+  }
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdlib>
+#include <chrono>
 #include <exception>
 #include <set>
 #include <fstream>
@@ -10,6 +11,10 @@
 #include <guttering_system.h>
 #include "supernode.h"
 #include "graph_configuration.h"
+#include "query_stats.h"
+#include "hw_counters.h"
+#include "ingest_metrics.h"
+#include "batch_stats.h"
 
 #ifdef VERIFY_SAMPLES_F
 #include "test/graph_verifier.h"
@@ -19,6 +24,7 @@
 
 // forward declarations
 class GraphWorker;
+class GraphWorkerStats;
 
 // Exceptions the Graph class may throw
 class UpdateLockedException : public std::exception {
@@ -34,6 +40,23 @@ class MultipleGraphsException : public std::exception {
   }
 };
 
+/**
+ * The supernodes to merge in a round of Boruvka in compressed sparse row form.
+ * children[offsets[i]] through children[offsets[i+1] - 1] are merged into roots[i].
+ */
+struct MergeLists {
+  std::vector<node_id_t> roots;
+  std::vector<size_t> offsets;
+  std::vector<node_id_t> children;
+
+  inline size_t num_lists() const { return roots.size(); }
+  inline void clear() {
+    roots.clear();
+    offsets.clear();
+    children.clear();
+  }
+};
+
 /**
  * Undirected graph object with n nodes labelled 0 to n-1, no self-edges,
  * multiple edges, or weights.
@@ -55,48 +78,178 @@ protected:
 #endif
   node_id_t* size;
   node_id_t get_parent(node_id_t node);
+  // find the root of node without path compression. Safe to call concurrently.
+  node_id_t get_root(node_id_t node) const;
   bool dsu_valid = true;
 
   std::unordered_set<node_id_t>* spanning_forest;
   std::mutex* spanning_forest_mtx;
 
+  // Deleting a spanning forest edge only invalidates the component that contains it.
+  // dirty_nodes holds an endpoint of every such deleted edge so that the next query
+  // can recover the dsu by running Boruvka over just those components.
+  std::vector<node_id_t> dirty_nodes;
+  std::mutex dirty_mtx;
+
+  // true if the dsu holds the exact connected components of the graph
+  inline bool dsu_exact() { return dsu_valid && dirty_nodes.empty(); }
+
+  /**
+   * Find every node belonging to a component that contains a dirty node.
+   * No edge leaves these components so they may be recomputed independently.
+   * @return the nodes of the dirty components.
+   */
+  std::vector<node_id_t> dirty_components();
+
+  // Query result cache. update_epoch is advanced by the first update() following a
+  // query. While it still equals cache_epoch, cc_labels holds the exact component
+  // root of every node and repeated queries can be answered without the DSU or Boruvka.
+  std::atomic<uint64_t> update_epoch;
+  uint64_t cache_epoch;
+  std::vector<node_id_t> cc_labels;
+  inline bool query_cache_valid() { return cache_epoch == update_epoch.load(); }
+
+  // fill cc_labels from the (valid) dsu and mark the query cache as valid
+  void cache_labels();
+
   // Guttering system for batching updates
   GutteringSystem *gts;
 
+  // Stream updates inserted into the guttering system by each inserter thread. Padded to a
+  // cache line so that inserters do not contend.
+  struct InsertCount {
+    std::atomic<uint64_t> num{0};
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+  int num_inserters;
+  InsertCount *inserted;
+  inline void count_inserted(int thr_id, uint64_t num) {
+    std::atomic<uint64_t> &count = inserted[thr_id].num;
+    count.store(count.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+  }
+  std::chrono::steady_clock::time_point create_time;
+
   void backup_to_disk(const std::vector<node_id_t>& ids_to_backup);
   void restore_from_disk(const std::vector<node_id_t>& ids_to_restore);
 
   /**
-   * Update the query array with new samples
-   * @param query  an array of supernode query results
+   * Determine the order in which to sample the representatives. Sampling supernodes in
+   * order of their address makes the memory accesses of the samplers more sequential.
+   * @param reps   an array containing node indices for the representative of each supernode
+   * @return the positions within reps in the order they should be sampled.
+   */
+  std::vector<node_id_t> sample_order(const std::vector<node_id_t> &reps);
+
+  /**
+   * Update the query vector with new samples
+   * @param query  a vector of supernode query results. query[i] is the result of reps[i]
    * @param reps   an array containing node indices for the representative of each supernode
    */
-  virtual void sample_supernodes(std::pair<Edge, SampleSketchRet> *query,
+  virtual void sample_supernodes(std::vector<std::pair<Edge, SampleSketchRet>> &query,
                           std::vector<node_id_t> &reps);
 
   /**
-   * @param copy_supernodes  an array to be filled with supernodes
-   * @param to_merge         an list of lists of supernodes to be merged
-   *
+   * Update the query vector with every edge an exhaustive query finds in each supernode
+   * @param query  a vector of supernode query results. query[i] is the result of reps[i]
+   * @param reps   an array containing node indices for the representative of each supernode
    */
-  void merge_supernodes(Supernode** copy_supernodes, std::vector<node_id_t> &new_reps,
-                        std::vector<std::vector<node_id_t>> &to_merge, bool make_copy);
+  virtual void exhaustive_sample_supernodes(
+      std::vector<std::pair<std::unordered_set<Edge>, SampleSketchRet>> &query,
+      std::vector<node_id_t> &reps);
+
+  /**
+   * Copy the supernodes that are about to be merged into so they may be restored.
+   * @param copies  filled with a copy of each supernode if backing up in memory.
+   *                copies[i] is the copy of ids[i].
+   * @param ids     the supernodes to back up
+   * @return the number of bytes copied
+   */
+  size_t backup_supernodes(std::vector<Supernode*> &copies, const std::vector<node_id_t> &ids);
+
+  /**
+   * @param to_merge  the lists of supernodes to be merged
+   * @return          the number of merge lists split into chunks among the threads
+   */
+  size_t merge_supernodes(const MergeLists &to_merge);
 
   /**
    * Run the disjoint set union to determine what supernodes
    * Should be merged together.
-   * Map from nodes to a vector of nodes to merge with them
-   * @param query  an array of supernode query results
-   * @param reps   an array containing node indices for the representative of each supernode
+   * @param query     a vector of supernode query results. query[i] is the result of reps[i]
+   * @param reps      an array containing node indices for the representative of each
+   *                  supernode. Replaced by the representatives for the next round.
+   * @param to_merge  filled with the lists of supernodes to be merged
+   */
+  void supernodes_to_merge(std::vector<std::pair<Edge, SampleSketchRet>> &query,
+                           std::vector<node_id_t> &reps, MergeLists &to_merge);
+
+  /**
+   * Version of supernodes_to_merge that merges upon every edge sampled from a supernode
+   * @param query     a vector of exhaustive query results. query[i] is the result of reps[i]
+   * @param reps      an array containing node indices for the representative of each
+   *                  supernode. Replaced by the representatives for the next round.
+   * @param to_merge  filled with the lists of supernodes to be merged
+   */
+  void supernodes_to_merge(
+      std::vector<std::pair<std::unordered_set<Edge>, SampleSketchRet>> &query,
+      std::vector<node_id_t> &reps, MergeLists &to_merge);
+
+  /**
+   * Merge the components of the endpoints of a sampled edge in the dsu.
+   * The representative that stops being a root is recorded in round_merged.
+   * @param edge      an edge sampled from a supernode
+   */
+  void merge_edge_in_dsu(Edge edge);
+
+#ifdef USE_EAGER_DSU
+  // Keep the eager dsu and spanning forest up to date with a stream update of edge
+  inline void eager_dsu_update(Edge edge) {
+    auto src = std::min(edge.src, edge.dst);
+    auto dst = std::max(edge.src, edge.dst);
+    std::lock_guard<std::mutex> sflock (spanning_forest_mtx[src]);
+    if (spanning_forest[src].find(dst) != spanning_forest[src].end()) {
+      std::lock_guard<std::mutex> dirty_lock (dirty_mtx);
+      dirty_nodes.push_back(src);
+    } else {
+      node_id_t a = src, b = dst;
+      while ((a = get_parent(a)) != (b = get_parent(b))) {
+        if (size[a] < size[b]) {
+          std::swap(a, b);
+        }
+        if (std::atomic_compare_exchange_weak(&parent[b], &b, a)) {
+          size[a] += size[b];
+          spanning_forest[src].insert(dst);
+          break;
+        }
+      }
+    }
+  }
+#endif // USE_EAGER_DSU
+
+  /**
+   * Group the representatives merged this round by their root and determine the
+   * representatives for the next round of Boruvka.
+   * @param to_merge  filled with the lists of supernodes to be merged this round
+   * @param reps      filled with the representatives for the next round
    */
-  std::vector<std::vector<node_id_t>> supernodes_to_merge(std::pair<Edge, SampleSketchRet> *query,
-                        std::vector<node_id_t> &reps);
+  void next_round_reps(MergeLists &to_merge, std::vector<node_id_t> &reps);
+
+  // Boruvka round state. Kept between rounds and queries so that its buffers are only
+  // allocated once and the cost of a round scales with the number of representatives.
+  std::vector<node_id_t> round_failed;  // reps whose sample failed this round
+  std::vector<node_id_t> round_merged;  // reps that stopped being a root this round
+  std::vector<std::pair<node_id_t, node_id_t>> round_pairs; // (root, merged rep) pairs
+  std::vector<std::pair<Edge, SampleSketchRet>> round_samples;
+  MergeLists round_to_merge;
+  std::vector<Supernode*> backup_copies; // in memory copies of the backed up supernodes
 
   /**
    * Main parallel algorithm utilizing Boruvka and L_0 sampling.
-   * @return a vector of the connected components in the graph.
+   * If the eager dsu is only invalid in some dirty components then Boruvka is run
+   * over the nodes of those components alone.
+   * When done the dsu and the query cache hold the connected components of the graph.
    */
-  std::vector<std::set<node_id_t>> boruvka_emulation(bool make_copy);
+  void boruvka_emulation(bool make_copy);
 
   /**
    * Generates connected components from this graph's dsu
@@ -104,6 +257,15 @@ protected:
    */
   std::vector<std::set<node_id_t>> cc_from_dsu();
 
+  /**
+   * Generates connected components from the cached labels
+   * @return a vector of the connected components in the graph.
+   */
+  std::vector<std::set<node_id_t>> cc_from_labels();
+
+  // record the path and timing hooks of the query that just completed in query_stats
+  void finish_query_stats(QueryPath path);
+
   std::string backup_file; // where to backup the supernodes
 
   FRIEND_TEST(GraphTestSuite, TestCorrectnessOfReheating);
@@ -126,29 +288,43 @@ public:
     if (update_locked) throw UpdateLockedException();
     Edge &edge = upd.edge;
 
+    // counted before inserting so that more updates are never applied than inserted
+    count_inserted(thr_id, 2);
     gts->insert({edge.src, edge.dst}, thr_id);
-    std::swap(edge.src, edge.dst);
-    gts->insert({edge.src, edge.dst}, thr_id);
+    gts->insert({edge.dst, edge.src}, thr_id);
+
+    // invalidate the query cache. Only the first update after a query writes the epoch
+    unlikely_if(update_epoch.load(std::memory_order_relaxed) == cache_epoch)
+      update_epoch.fetch_add(1, std::memory_order_relaxed);
+#ifdef USE_EAGER_DSU
+    if (dsu_valid) eager_dsu_update(edge);
+#else
+    unlikely_if(dsu_valid) dsu_valid = false;
+#endif // USE_EAGER_DSU
+  }
+
+  /**
+   * Apply an array of stream updates to the graph. Equivalent to calling update() upon
+   * each of them but the update lock and query cache are only checked once.
+   * @param upds    the updates to apply
+   * @param num     the number of updates in upds
+   * @param thr_id  the id of the calling inserter thread
+   */
+  inline void update_batch(const GraphUpdate *upds, size_t num, int thr_id = 0) {
+    if (update_locked) throw UpdateLockedException();
+    if (num == 0) return;
+
+    count_inserted(thr_id, 2 * num);
+    for (size_t i = 0; i < num; i++) {
+      gts->insert({upds[i].edge.src, upds[i].edge.dst}, thr_id);
+      gts->insert({upds[i].edge.dst, upds[i].edge.src}, thr_id);
+    }
+
+    unlikely_if(update_epoch.load(std::memory_order_relaxed) == cache_epoch)
+      update_epoch.fetch_add(1, std::memory_order_relaxed);
 #ifdef USE_EAGER_DSU
     if (dsu_valid) {
-      auto src = std::min(edge.src, edge.dst);
-      auto dst = std::max(edge.src, edge.dst);
-      std::lock_guard<std::mutex> sflock (spanning_forest_mtx[src]);
-      if (spanning_forest[src].find(dst) != spanning_forest[src].end()) {
-        dsu_valid = false;
-      } else {
-        node_id_t a = src, b = dst;
-        while ((a = get_parent(a)) != (b = get_parent(b))) {
-          if (size[a] < size[b]) {
-            std::swap(a, b);
-          }
-          if (std::atomic_compare_exchange_weak(&parent[b], &b, a)) {
-            size[a] += size[b];
-            spanning_forest[src].insert(dst);
-            break;
-          }
-        }
-      }
+      for (size_t i = 0; i < num; i++) eager_dsu_update(upds[i].edge);
     }
 #else
     unlikely_if(dsu_valid) dsu_valid = false;
@@ -161,8 +337,10 @@ public:
    * @param edges      A vector of destinations.
    * @param delta_loc  Memory location where we should initialize the delta
    *                   supernode.
+   * @param stats      If not null, the ingestion counters of the calling GraphWorker.
    */
-  void batch_update(node_id_t src, const std::vector<node_id_t> &edges, Supernode *delta_loc);
+  void batch_update(node_id_t src, const std::vector<node_id_t> &edges, Supernode *delta_loc,
+                    GraphWorkerStats *stats = nullptr);
 
   /**
    * Main parallel query algorithm utilizing Boruvka and L_0 sampling.
@@ -180,6 +358,16 @@ public:
    */
   bool point_query(node_id_t a, node_id_t b);
 
+  /**
+   * Batched point query algorithm. Flushes and runs Boruvka at most once and then
+   * answers every pair against the resulting DSU in parallel.
+   * Allows for additional updates when done.
+   * @param pairs  the (a, b) node pairs to query.
+   * @return a vector where entry i is true if the nodes of pairs[i] are in the same
+   *         connected component, false otherwise.
+   */
+  std::vector<bool> point_queries(const std::vector<std::pair<node_id_t, node_id_t>> &pairs);
+
 
 #ifdef VERIFY_SAMPLES_F
   std::unique_ptr<GraphVerifier> verifier;
@@ -194,6 +382,8 @@ public:
 
   // number of updates
   std::atomic<uint64_t> num_updates;
+  // number of batches of updates applied to the sketches
+  std::atomic<uint64_t> num_batches;
 
   /**
    * Generate a delta node for the purposes of updating a node sketch
@@ -221,4 +411,23 @@ public:
   std::chrono::steady_clock::time_point flush_end;
   std::chrono::steady_clock::time_point cc_alg_start;
   std::chrono::steady_clock::time_point cc_alg_end;
+
+  // statistics describing where the time of the most recent query went
+  QueryStats query_stats;
+
+  /**
+   * A snapshot of the ingestion state: the updates buffered by the guttering system and the
+   * counters of each GraphWorker. Safe to call from any thread while the graph is open.
+   */
+  IngestMetrics ingest_metrics();
+
+  /**
+   * The batch size histograms and hottest nodes of the GraphWorkers, aggregated when the
+   * workers were last paused by a query that flushed the guttering system.
+   */
+  WorkerBatchStats worker_batch_stats();
+
+  // hardware event counts of the hot paths. Only counted if enabled in the configuration
+  HwCounters hw_counters;
+  HwCounterStats hw_counter_stats() { return hw_counters.stats(); }
 };
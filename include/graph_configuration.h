@@ -30,6 +30,12 @@ private:
   // How many OMP threads each graph worker uses
   size_t _group_size = 1;
 
+  // Merge on every edge returned by an exhaustive sketch query in each Boruvka round
+  bool _exhaustive_boruvka = false;
+
+  // Count hardware events around the hot paths with perf_event_open
+  bool _hw_counters = false;
+
   // Configuration for the guttering system
   GutteringConfiguration _gutter_conf;
 
@@ -49,6 +55,10 @@ public:
 
   GraphConfiguration& group_size(size_t group_size);
 
+  GraphConfiguration& exhaustive_boruvka(bool exhaustive_boruvka);
+
+  GraphConfiguration& hw_counters(bool hw_counters);
+
   GutteringConfiguration& gutter_conf();
 
   friend std::ostream& operator<< (std::ostream &out, const GraphConfiguration &conf);
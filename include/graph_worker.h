@@ -1,13 +1,56 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 
+#include "ingest_metrics.h"
+#include "batch_stats.h"
+
 // forward declarations
 class Graph;
 class Supernode;
 class GutteringSystem;
 
+/**
+ * Live ingestion counters of a GraphWorker. Only written by the thread of the worker so
+ * updates are relaxed stores rather than atomic read-modify-writes. May be read at any time.
+ */
+class GraphWorkerStats {
+private:
+  std::atomic<uint64_t> batches{0};
+  std::atomic<uint64_t> updates{0};
+  std::atomic<uint64_t> wait_ns{0};
+  std::atomic<uint64_t> delta_ns{0};
+  std::atomic<uint64_t> apply_ns{0};
+  std::atomic<uint64_t> lock_wait_ns{0};
+  std::atomic<bool> waiting{false};
+
+  static inline void add(std::atomic<uint64_t> &counter, uint64_t val) {
+    counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+  }
+
+public:
+  using nanoseconds = std::chrono::nanoseconds;
+
+  inline void record_wait(nanoseconds wait) { add(wait_ns, wait.count()); }
+  inline void set_waiting(bool val) { waiting.store(val, std::memory_order_relaxed); }
+
+  // record a batch of num_upds updates and the time spent upon it
+  inline void record_batch(size_t num_upds, nanoseconds delta, nanoseconds apply,
+                           nanoseconds lock_wait) {
+    add(batches, 1);
+    add(updates, num_upds);
+    add(delta_ns, delta.count());
+    add(apply_ns, apply.count());
+    add(lock_wait_ns, lock_wait.count());
+  }
+
+  // a snapshot of the counters
+  WorkerMetrics metrics() const;
+};
+
 class GraphWorker {
 public:
   /**
@@ -34,6 +77,18 @@ public:
   static int get_num_groups() {return num_groups;} // return the number of GraphWorkers
   static int get_group_size() {return group_size;} // return the number of threads in each worker
   static void set_config(int g, int s) { num_groups = g; group_size = s; }
+
+  /**
+   * Returns a snapshot of the ingestion counters of every GraphWorker.
+   * Must be called between start_workers and stop_workers.
+   */
+  static std::vector<WorkerMetrics> get_metrics();
+
+  /**
+   * Returns the batch size histograms and hottest nodes of the GraphWorkers. These are
+   * aggregated whenever the workers are paused for a query and when they are stopped.
+   */
+  static WorkerBatchStats get_batch_stats();
 private:
   /**
    * Create a GraphWorker object by setting metadata and spinning up a thread.
@@ -58,6 +113,10 @@ private:
   int id;
   Graph *graph;
   GutteringSystem *gts;
+  GraphWorkerStats stats; // constructed before thr starts running do_work
+  // only accessed by the thread of this worker or while it is paused or stopped
+  BatchSizeHistogram batch_sizes;
+  HeavyHitters hot_nodes;
   std::thread thr;
   bool thr_paused; // indicates if this individual thread is paused
 
@@ -75,6 +134,11 @@ private:
   // list of all GraphWorkers
   static GraphWorker **workers;
 
+  // the batch statistics of all GraphWorkers when they were last paused or stopped
+  static void aggregate_batch_stats();
+  static WorkerBatchStats batch_stats;
+  static std::mutex batch_stats_lock;
+
   // the supernode object this GraphWorker will use for generating deltas
   Supernode *delta_node;
 };
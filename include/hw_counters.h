@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Events counted by HwCounters
+enum HwEvent {
+  HW_TASK_CLOCK,    // nanoseconds spent running (a software event that is always available)
+  HW_CYCLES,
+  HW_INSTRUCTIONS,
+  HW_LLC_MISSES,    // last level cache load misses
+  HW_DTLB_MISSES,   // data TLB load misses
+  HW_BRANCH_MISSES,
+  NUM_HW_EVENTS
+};
+
+// Code regions measured by HwCounters
+enum HwRegion {
+  DELTA_REGION,  // generating the delta supernode of a batch (hashing and Sketch::update)
+  APPLY_REGION,  // Supernode::apply_delta_update
+  SAMPLE_REGION, // sampling the supernodes in a round of Boruvka
+  MERGE_REGION,  // merging the supernodes in a round of Boruvka
+  NUM_HW_REGIONS
+};
+
+// Event counts accumulated over the calls of a region
+struct HwCounts {
+  uint64_t calls = 0;
+  uint64_t events[NUM_HW_EVENTS] = {};
+
+  HwCounts& operator+=(const HwCounts &oth);
+};
+
+// The counts of each region measured upon one thread
+struct HwThreadCounts {
+  std::string name;
+  HwCounts regions[NUM_HW_REGIONS];
+};
+
+// Hardware counter statistics of a Graph
+struct HwCounterStats {
+  bool enabled = false;
+  bool supported[NUM_HW_EVENTS] = {}; // events that could be opened by every thread
+  std::vector<HwThreadCounts> threads;
+
+  // the counts of region summed over every thread
+  HwCounts total(HwRegion region) const;
+
+  friend std::ostream& operator<< (std::ostream &out, const HwCounterStats &stats);
+};
+
+/**
+ * Optional hardware performance counters, read with perf_event_open, around the hot paths of
+ * the library. Each thread that measures a region opens its own group of counters upon first
+ * use. Only user space is counted. Events that cannot be opened (perf_event_paranoid, virtual
+ * machines without a PMU, or kernels without perf events) are reported as unsupported and
+ * read as zero. Counts are scaled if the kernel multiplexed the counters.
+ */
+class HwCounters {
+private:
+  struct ThreadCounters;
+
+  bool enabled;
+  uint64_t instance_id; // distinguishes the thread local counters of different instances
+  std::mutex threads_mtx;
+  std::vector<std::unique_ptr<ThreadCounters>> threads;
+
+  // the counters of the calling thread, opened upon first use
+  ThreadCounters *local();
+
+public:
+  explicit HwCounters(bool enabled);
+  ~HwCounters();
+
+  bool is_enabled() const { return enabled; }
+
+  // name the calling thread in the statistics
+  void name_thread(const std::string &name);
+
+  // return the counts of every thread that measured a region
+  HwCounterStats stats();
+
+  // zero the counts of every thread
+  void reset();
+
+  // Measures a region upon the calling thread from construction to destruction
+  class Scope {
+  public:
+    Scope(HwCounters &counters, HwRegion region) :
+     thr(counters.enabled ? counters.local() : nullptr), region(region) {
+      if (thr != nullptr) begin();
+    }
+    ~Scope() { if (thr != nullptr) end(); }
+
+    Scope(const Scope &) = delete;
+    Scope& operator=(const Scope &) = delete;
+  private:
+    ThreadCounters *thr;
+    HwRegion region;
+    uint64_t start[NUM_HW_EVENTS + 2]; // event values followed by time enabled and running
+
+    void begin();
+    void end();
+  };
+};
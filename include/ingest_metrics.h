@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Ingestion counters of one GraphWorker
+struct WorkerMetrics {
+  uint64_t batches = 0;      // batches applied to the sketches
+  uint64_t updates = 0;      // updates within those batches
+  double wait_time = 0;      // seconds blocked in get_data waiting for a batch
+  double delta_time = 0;     // seconds generating delta supernodes
+  double apply_time = 0;     // seconds applying deltas, including lock_wait_time
+  double lock_wait_time = 0; // seconds waiting to lock the supernode of a batch
+  bool waiting = false;      // if the worker is currently waiting in get_data
+
+  double avg_batch_size() const { return batches == 0 ? 0 : (double) updates / batches; }
+};
+
+// A snapshot of the ingestion state of a Graph
+struct IngestMetrics {
+  double uptime = 0;             // seconds since the graph was created
+  uint64_t updates_inserted = 0; // updates inserted into the guttering system
+  uint64_t updates_applied = 0;  // updates applied to the sketches
+  size_t workers_waiting = 0;    // workers currently waiting in get_data for a batch
+  std::vector<WorkerMetrics> workers;
+
+  // updates in the guttering system that have not been applied to the sketches
+  uint64_t gutter_backlog() const {
+    return updates_inserted > updates_applied ? updates_inserted - updates_applied : 0;
+  }
+
+  // write the metrics as a single line of json
+  void write_json(std::ostream &out) const;
+
+  // write the metrics in the Prometheus text exposition format
+  void write_prometheus(std::ostream &out) const;
+};
@@ -46,8 +46,25 @@ class Sketch {
   bool already_queried = false;
 
   FRIEND_TEST(SketchTestSuite, TestExceptions);
+  FRIEND_TEST(SketchTestSuite, TestVectorizedQueryKernel);
   FRIEND_TEST(EXPR_Parallelism, N10kU100k);
 
+  /**
+   * Find the first good bucket among num buckets.
+   * @param a      the a values of the buckets
+   * @param c      the c values of the buckets
+   * @param num    the number of buckets to search
+   * @param seed   the checksum seed of the sketch
+   * @return       the index of the first good bucket or num if there is none.
+   */
+  static size_t first_good_bucket_scalar(const vec_t* a, const vec_hash_t* c, size_t num,
+                                         uint64_t seed);
+  // Version of first_good_bucket_scalar that checks 4 buckets at a time using AVX2
+  static size_t first_good_bucket_avx2(const vec_t* a, const vec_hash_t* c, size_t num,
+                                       uint64_t seed);
+  // the fastest version of first_good_bucket supported by this cpu
+  static size_t (*const first_good_bucket)(const vec_t*, const vec_hash_t*, size_t, uint64_t);
+
   // Buckets of this sketch.
   // Length is column_gen(failure_factor) * guess_gen(n).
   // For buckets[i * guess_gen(n) + j], the bucket has a 1/2^j probability
@@ -107,6 +124,13 @@ class Sketch {
 
   inline void reset_queried() { already_queried = false; }
 
+  // prefetch the buckets that query() reads first into the cache
+  inline void prefetch() const {
+    __builtin_prefetch(buckets);
+    __builtin_prefetch(buckets + (num_elems - 1) * sizeof(vec_t));
+    __builtin_prefetch(buckets + num_elems * sizeof(vec_t) + (num_elems - 1) * sizeof(vec_hash_t));
+  }
+
   inline static size_t get_columns() { return num_columns; }
 
   /**
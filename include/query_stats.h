@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+// How a query was answered
+enum QueryPath {
+  CACHED,    // from the labels cached by the previous query
+  EAGER_DSU, // from the eagerly maintained dsu
+  BORUVKA    // by running Boruvka upon the sketches
+};
+
+// Statistics describing one round of Boruvka
+struct BoruvkaRoundStats {
+  size_t num_reps = 0;   // number of supernodes sampled this round
+  size_t num_good = 0;   // samples that returned an edge
+  size_t num_zero = 0;   // samples that found the cut to be empty
+  size_t num_fail = 0;   // samples that failed and are retried next round
+  size_t num_merges = 0; // number of supernodes merged into another this round
+  size_t num_split = 0;  // merge lists split into chunks merged by several threads
+
+  std::chrono::duration<double> sample_time{0}; // sampling the supernodes
+  std::chrono::duration<double> dsu_time{0};    // finding the supernodes to merge
+  std::chrono::duration<double> backup_time{0}; // backing up supernodes before merging
+  std::chrono::duration<double> merge_time{0};  // merging the supernodes
+  std::chrono::duration<double> round_time{0};  // total time spent on the round
+};
+
+// Statistics describing the most recent query of a Graph
+struct QueryStats {
+  QueryPath path = CACHED;
+  size_t backup_bytes = 0;  // bytes copied to back up supernodes (memory or disk)
+  size_t restore_bytes = 0; // bytes copied to restore supernodes after the query
+
+  std::chrono::duration<double> flush_time{0};   // flushing the guttering system
+  std::chrono::duration<double> alg_time{0};     // answering the query after the flush
+  std::chrono::duration<double> restore_time{0}; // restoring the backed up supernodes
+
+  std::vector<BoruvkaRoundStats> rounds; // empty unless path is BORUVKA
+
+  friend std::ostream& operator<< (std::ostream &out, const QueryStats &stats);
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <chrono>
 #include <fstream>
 #include <sys/mman.h>
 #include <graph_zeppelin_common.h>
@@ -137,6 +138,11 @@ public:
     return reinterpret_cast<Sketch*>(sketch_buffer + i * sketch_size);
   }
 
+  // prefetch the sketch that the next call to sample() will query
+  inline void prefetch_sample() const {
+    if (sample_idx < merged_sketches) get_sketch(sample_idx)->prefetch();
+  }
+
   /**
    * Function to sample an edge from the cut of a supernode.
    * @return   an edge in the cut, represented as an Edge with LHS <= RHS, 
@@ -179,8 +185,9 @@ public:
    * Update all the sketches in a supernode, given a batch of updates.
    * @param delta_node  a delta supernode created through calling
    *                    Supernode::delta_supernode.
+   * @return the time spent waiting to lock the supernode.
    */
-  void apply_delta_update(const Supernode* delta_node);
+  std::chrono::nanoseconds apply_delta_update(const Supernode* delta_node);
 
   /**
    * Create new delta supernode with given initial parmameters and batch of
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <string>
 
 void write_edges(uint32_t n, double p, const std::string& out_f);
 // insert, delete based on a geometric distribution with ratio p
@@ -7,3 +9,11 @@ void write_edges(uint32_t n, double p, const std::string& out_f);
 void insert_delete(double p, const std::string& in_file, const std::string& out_file);
 
 void write_cumul(const std::string& stream_f, const std::string& cumul_f);
+
+// generate the stream of write_edges followed by insert_delete directly in the binary
+// stream format, in one pass upon num_threads threads. If cumul_file is not empty the
+// final graph is written to it as a binary stream of insertions (compact if possible).
+// FileGraphVerifier only reads the compact cumul, so n must fit in 31 bits to verify.
+// returns the number of updates in the stream
+uint64_t write_binary_stream(uint32_t n, double p, double r, const std::string& out_file,
+                             const std::string& cumul_file, int num_threads, uint64_t seed);
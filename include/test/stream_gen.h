@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <graph_zeppelin_common.h>
+
+enum StreamGenModel {
+  ERDOS_RENYI, // every pair of nodes is equally likely to be an edge
+  RMAT,        // recursive matrix (Kronecker) graph. num_nodes must be a power of 2
+  POWER_LAW,   // Chung-Lu graph whose expected degrees follow a power law
+};
+
+struct StreamGenSettings {
+  StreamGenModel model = ERDOS_RENYI;
+  node_id_t num_nodes  = 1024;
+  edge_id_t num_edges  = 1024;    // number of distinct edges inserted by the stream
+  double churn         = 0;       // geometric deletion/reinsertion ratio, see insert_delete()
+  double rmat_a = 0.57, rmat_b = 0.19, rmat_c = 0.19; // R-MAT quadrant probabilities
+  double power_law_exponent = 2.5;  // exponent of the degree distribution. Must exceed 2
+  uint64_t seed        = 0;
+  int num_threads      = 1;
+  bool compact         = false;   // write 8 byte updates rather than the raw 9 byte format
+  size_t max_shard_edges = 1 << 22; // bounds the memory used by each generating thread
+  std::string out_file = "./sample.data";
+};
+
+/*
+ * Counter-based random number generator. The value of the i'th draw depends only upon
+ * the key and i so any range of draws can be generated independently of the others.
+ */
+class CounterRng {
+public:
+  CounterRng(uint64_t seed, uint64_t stream) : key(mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ULL))) {}
+
+  inline uint64_t operator()(uint64_t counter) const {
+    return mix(key + counter * 0x9E3779B97F4A7C15ULL);
+  }
+
+  // uniform double in [0, 1)
+  inline double uniform(uint64_t counter) const {
+    return (double) ((*this)(counter) >> 11) * 0x1.0p-53;
+  }
+
+  // uniform integer in [0, range)
+  inline uint64_t bounded(uint64_t counter, uint64_t range) const {
+    return (uint64_t) (((unsigned __int128) (*this)(counter) * range) >> 64);
+  }
+
+  // splitmix64 finalizer
+  static inline uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+private:
+  uint64_t key;
+};
+
+/*
+ * A pseudorandom permutation of [0, size) evaluated one index at a time. A balanced Feistel
+ * network upon the smallest even number of bits covering size, cycle walking until the
+ * result is in range.
+ */
+class IndexPermutation {
+public:
+  IndexPermutation(uint64_t size, uint64_t seed) : size(size) {
+    while (2 * half_bits < 64 && (1ull << (2 * half_bits)) < size) half_bits++;
+    mask = (1ull << half_bits) - 1;
+    for (uint64_t r = 0; r < num_rounds; r++) rounds.emplace_back(seed, r);
+  }
+
+  inline uint64_t operator()(uint64_t idx) const {
+    do { idx = encrypt(idx); } while (idx >= size);
+    return idx;
+  }
+
+private:
+  static constexpr uint64_t num_rounds = 4;
+  uint64_t size;
+  uint64_t half_bits = 1;
+  uint64_t mask;
+  std::vector<CounterRng> rounds;
+
+  inline uint64_t encrypt(uint64_t x) const {
+    uint64_t left = x >> half_bits, right = x & mask;
+    for (const CounterRng &round : rounds) {
+      uint64_t next = left ^ (round(right) & mask);
+      left = right;
+      right = next;
+    }
+    return left << half_bits | right;
+  }
+};
+
+/**
+ * Generates a synthetic graph stream and writes it directly in the binary stream format.
+ * The adjacency matrix is divided into cells by node range and each cell is generated
+ * independently by a thread, so the output is identical regardless of the number of
+ * threads. Memory use is bounded by the edges of the cells in flight, at most
+ * max_shard_edges per thread, plus 64 MiB of bookkeeping for at most 2^20 cells. If the
+ * largest cell cannot be brought under max_shard_edges within that many cells a warning
+ * is printed.
+ * The stream inserts every edge and then deletes and reinserts a geometrically shrinking
+ * number of them, as in insert_delete(). Within each of these phases the cells are
+ * interleaved by shuffling fixed size slots of updates.
+ * @return the number of updates in the stream
+ */
+edge_id_t generate_binary_stream(const StreamGenSettings& settings);
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iostream>
+
+#include "../include/batch_stats.h"
+
+void BatchSizeHistogram::merge(const BatchSizeHistogram &oth) {
+  for (size_t b = 0; b < num_buckets; b++) counts[b] += oth.counts[b];
+}
+
+uint64_t BatchSizeHistogram::total() const {
+  uint64_t sum = 0;
+  for (size_t b = 0; b < num_buckets; b++) sum += counts[b];
+  return sum;
+}
+
+uint64_t BatchSizeHistogram::percentile(double p) const {
+  uint64_t num = total();
+  if (num == 0) return 0;
+  uint64_t rank = std::max((uint64_t) 1, (uint64_t) (p * num + 0.5));
+  uint64_t seen = 0;
+  for (size_t b = 0; b < num_buckets; b++) {
+    seen += counts[b];
+    if (seen >= rank) return 2ull << b;
+  }
+  return 2ull << (num_buckets - 1);
+}
+
+void HeavyHitters::swap_entries(size_t a, size_t b) {
+  std::swap(entries[a], entries[b]);
+  index[entries[a].node] = a;
+  index[entries[b].node] = b;
+}
+
+void HeavyHitters::sift_down(size_t pos) {
+  while (true) {
+    size_t min = pos;
+    for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < entries.size(); child++)
+      if (entries[child].count < entries[min].count) min = child;
+    if (min == pos) return;
+    swap_entries(pos, min);
+    pos = min;
+  }
+}
+
+void HeavyHitters::sift_up(size_t pos) {
+  while (pos > 0 && entries[pos].count < entries[(pos - 1) / 2].count) {
+    swap_entries(pos, (pos - 1) / 2);
+    pos = (pos - 1) / 2;
+  }
+}
+
+void HeavyHitters::insert(node_id_t node, uint64_t weight) {
+  if (entries.size() < capacity) {
+    index[node] = entries.size();
+    entries.push_back({node, weight, 0});
+    sift_up(entries.size() - 1);
+    return;
+  }
+  // replace the counter with the smallest count, the root of the heap
+  HeavyHitter &victim = entries[0];
+  index.erase(victim.node);
+  index[node] = 0;
+  victim = {node, victim.count + weight, victim.count};
+  sift_down(0);
+}
+
+uint64_t HeavyHitters::min_count() const {
+  if (entries.empty() || entries.size() < capacity) return 0;
+  return entries[0].count;
+}
+
+void HeavyHitters::merge(const HeavyHitters &oth) {
+  uint64_t this_min = min_count();
+  uint64_t oth_min = oth.min_count();
+
+  std::unordered_map<node_id_t, HeavyHitter> merged;
+  for (auto &entry : entries)
+    merged[entry.node] = {entry.node, entry.count + oth_min, entry.error + oth_min};
+  for (auto &entry : oth.entries) {
+    auto it = merged.find(entry.node);
+    if (it == merged.end()) {
+      merged[entry.node] = {entry.node, entry.count + this_min, entry.error + this_min};
+    } else {
+      // tracked by both so remove the estimate of the other summary
+      it->second.count += entry.count - oth_min;
+      it->second.error += entry.error - oth_min;
+    }
+  }
+
+  entries.clear();
+  index.clear();
+  for (auto &kv : merged) entries.push_back(kv.second);
+  std::sort(entries.begin(), entries.end(), [](const HeavyHitter &a, const HeavyHitter &b) {
+    return a.count > b.count || (a.count == b.count && a.node < b.node);
+  });
+  if (entries.size() > capacity) entries.resize(capacity);
+  // sorted by decreasing count so reversing gives a valid min-heap
+  std::reverse(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size(); i++) index[entries[i].node] = i;
+  total += oth.total;
+}
+
+std::vector<HeavyHitter> HeavyHitters::top(size_t k) const {
+  std::vector<HeavyHitter> ret = entries;
+  std::sort(ret.begin(), ret.end(), [](const HeavyHitter &a, const HeavyHitter &b) {
+    return a.count > b.count || (a.count == b.count && a.node < b.node);
+  });
+  if (ret.size() > k) ret.resize(k);
+  return ret;
+}
+
+std::ostream& operator<< (std::ostream &out, const WorkerBatchStats &stats) {
+  auto print_histogram = [&](const BatchSizeHistogram &hist) {
+    out << " batches=" << hist.total() << " p50<" << hist.percentile(0.5)
+        << " p90<" << hist.percentile(0.9) << " p99<" << hist.percentile(0.99) << std::endl;
+    out << "   sizes:";
+    for (size_t b = 0; b < BatchSizeHistogram::num_buckets; b++)
+      if (hist.count(b) > 0) out << " [" << (1ull << b) << "," << (2ull << b) << ")=" << hist.count(b);
+    out << std::endl;
+  };
+
+  out << "GraphWorker Batch Statistics:" << std::endl;
+  out << " All workers:";
+  print_histogram(stats.batch_sizes);
+  for (size_t w = 0; w < stats.worker_batch_sizes.size(); w++) {
+    out << "  Worker " << w << ":";
+    print_histogram(stats.worker_batch_sizes[w]);
+  }
+
+  uint64_t total = stats.hot_nodes.total_weight();
+  out << " Hottest nodes (updates, share of " << total << "):" << std::endl;
+  for (const HeavyHitter &hh : stats.hot_nodes.top(10)) {
+    out << "  node " << hh.node << ": " << hh.count - hh.error << "-" << hh.count;
+    if (total > 0) out << " (" << 100.0 * hh.count / total << "%)";
+    out << std::endl;
+  }
+  return out;
+}
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <omp.h>
 
 #include <gutter_tree.h>
 #include <standalone_gutters.h>
@@ -14,7 +15,8 @@
 bool Graph::open_graph = false;
 
 Graph::Graph(node_id_t num_nodes, GraphConfiguration config, int num_inserters) : 
- num_nodes(num_nodes), config(config), num_updates(0) {
+ num_nodes(num_nodes), update_epoch(0), cache_epoch(-1), config(config), num_updates(0), num_batches(0),
+ hw_counters(config._hw_counters) {
   if (open_graph) throw MultipleGraphsException();
 
 #ifdef VERIFY_SAMPLES_F
@@ -37,6 +39,9 @@ Graph::Graph(node_id_t num_nodes, GraphConfiguration config, int num_inserters)
   }
   
   backup_file = config._disk_dir + "supernode_backup.data";
+  this->num_inserters = std::max(num_inserters, 1);
+  inserted = new InsertCount[this->num_inserters];
+  create_time = std::chrono::steady_clock::now();
   // Create the guttering system
   if (config._gutter_sys == GUTTERTREE)
     gts = new GutterTree(config._disk_dir, num_nodes, config._num_groups, config._gutter_conf, true);
@@ -55,7 +60,8 @@ Graph::Graph(node_id_t num_nodes, GraphConfiguration config, int num_inserters)
 }
 
 Graph::Graph(const std::string& input_file, GraphConfiguration config, int num_inserters) : 
- config(config), num_updates(0) {
+ update_epoch(0), cache_epoch(-1), config(config), num_updates(0), num_batches(0),
+ hw_counters(config._hw_counters) {
   if (open_graph) throw MultipleGraphsException();
   
   vec_t sketch_fail_factor;
@@ -81,6 +87,9 @@ Graph::Graph(const std::string& input_file, GraphConfiguration config, int num_i
   binary_in.close();
 
   backup_file = config._disk_dir + "supernode_backup.data";
+  this->num_inserters = std::max(num_inserters, 1);
+  inserted = new InsertCount[this->num_inserters];
+  create_time = std::chrono::steady_clock::now();
   // Create the guttering system
   if (config._gutter_sys == GUTTERTREE)
     gts = new GutterTree(config._disk_dir, num_nodes, config._num_groups, config._gutter_conf, true);
@@ -107,6 +116,7 @@ Graph::~Graph() {
   delete representatives;
   GraphWorker::stop_workers(); // join the worker threads
   delete gts;
+  delete[] inserted;
   open_graph = false;
   delete[] spanning_forest;
   delete[] spanning_forest_mtx;
@@ -127,46 +137,188 @@ void Graph::generate_delta_node(node_id_t node_n, uint64_t node_seed, node_id_t
   }
   Supernode::delta_supernode(node_n, node_seed, updates, delta_loc);
 }
-void Graph::batch_update(node_id_t src, const std::vector<node_id_t> &edges, Supernode *delta_loc) {
+void Graph::batch_update(node_id_t src, const std::vector<node_id_t> &edges, Supernode *delta_loc,
+                         GraphWorkerStats *stats) {
   if (update_locked) throw UpdateLockedException();
 
+  auto delta_start = std::chrono::steady_clock::now();
+  {
+    HwCounters::Scope hw_scope(hw_counters, DELTA_REGION);
+    generate_delta_node(supernodes[src]->n, supernodes[src]->seed, src, edges, delta_loc);
+  }
+  auto apply_start = std::chrono::steady_clock::now();
+  std::chrono::nanoseconds lock_wait;
+  {
+    HwCounters::Scope hw_scope(hw_counters, APPLY_REGION);
+    lock_wait = supernodes[src]->apply_delta_update(delta_loc);
+  }
+  if (stats != nullptr)
+    stats->record_batch(edges.size(), apply_start - delta_start,
+                        std::chrono::steady_clock::now() - apply_start, lock_wait);
   num_updates += edges.size();
-  generate_delta_node(supernodes[src]->n, supernodes[src]->seed, src, edges, delta_loc);
-  supernodes[src]->apply_delta_update(delta_loc);
+  num_batches++;
+}
+
+WorkerBatchStats Graph::worker_batch_stats() {
+  return GraphWorker::get_batch_stats();
+}
+
+IngestMetrics Graph::ingest_metrics() {
+  IngestMetrics metrics;
+  // read the applied updates first so that they do not exceed the inserted updates
+  metrics.updates_applied = num_updates.load();
+  for (int t = 0; t < num_inserters; t++) metrics.updates_inserted += inserted[t].num.load();
+  metrics.workers = GraphWorker::get_metrics();
+  for (auto &worker : metrics.workers) metrics.workers_waiting += worker.waiting;
+  metrics.uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - create_time).count();
+  return metrics;
 }
 
-inline void Graph::sample_supernodes(std::pair<Edge, SampleSketchRet> *query,
+std::vector<node_id_t> Graph::sample_order(const std::vector<node_id_t> &reps) {
+  std::vector<node_id_t> order(reps.size());
+  for (node_id_t i = 0; i < reps.size(); ++i) order[i] = i;
+
+  // supernodes are allocated in order so the first round is usually sorted already
+  auto by_address = [this, &reps](node_id_t i, node_id_t j) {
+    return supernodes[reps[i]] < supernodes[reps[j]];
+  };
+  if (!std::is_sorted(order.begin(), order.end(), by_address))
+    std::sort(order.begin(), order.end(), by_address);
+  return order;
+}
+
+// number of positions each sampling thread claims at once. Later rounds sample few
+// supernodes with large differences in cost so claim fewer positions at a time.
+static inline size_t sample_chunk_size(size_t num_reps) {
+  return std::max((size_t) 1, num_reps / (omp_get_max_threads() * 64));
+}
+
+inline void Graph::sample_supernodes(std::vector<std::pair<Edge, SampleSketchRet>> &query,
                std::vector<node_id_t> &reps) {
   bool except = false;
   std::exception_ptr err;
-  #pragma omp parallel for default(none) shared(query, reps, except, err)
-  for (node_id_t i = 0; i < reps.size(); ++i) { // NOLINT(modernize-loop-convert)
-    // wrap in a try/catch because exiting through exception is undefined behavior in OMP
-    try {
-      query[reps[i]] = supernodes[reps[i]]->sample();
+  std::vector<node_id_t> order = sample_order(reps);
+  size_t chunk = sample_chunk_size(reps.size());
+  query.resize(reps.size());
+  #pragma omp parallel default(none) shared(query, reps, order, chunk, except, err)
+  {
+    // nowait so the scope ends before the barrier and does not count the time spent in it
+    HwCounters::Scope hw_scope(hw_counters, SAMPLE_REGION);
+    #pragma omp for schedule(dynamic, chunk) nowait
+    for (node_id_t i = 0; i < order.size(); ++i) { // NOLINT(modernize-loop-convert)
+      // wrap in a try/catch because exiting through exception is undefined behavior in OMP
+      try {
+        if (i + 1 < order.size()) supernodes[reps[order[i + 1]]]->prefetch_sample();
+        query[order[i]] = supernodes[reps[order[i]]]->sample();
+
+      } catch (...) {
+        except = true;
+        err = std::current_exception();
+      }
+    }
+  }
+  // Did one of our threads produce an exception?
+  if (except) std::rethrow_exception(err);
+}
 
-    } catch (...) {
-      except = true;
-      err = std::current_exception();
+inline void Graph::exhaustive_sample_supernodes(
+    std::vector<std::pair<std::unordered_set<Edge>, SampleSketchRet>> &query,
+    std::vector<node_id_t> &reps) {
+  bool except = false;
+  std::exception_ptr err;
+  std::vector<node_id_t> order = sample_order(reps);
+  size_t chunk = sample_chunk_size(reps.size());
+  #pragma omp parallel default(none) shared(query, reps, order, chunk, except, err)
+  {
+    // nowait so the scope ends before the barrier and does not count the time spent in it
+    HwCounters::Scope hw_scope(hw_counters, SAMPLE_REGION);
+    #pragma omp for schedule(dynamic, chunk) nowait
+    for (node_id_t i = 0; i < order.size(); ++i) { // NOLINT(modernize-loop-convert)
+      // wrap in a try/catch because exiting through exception is undefined behavior in OMP
+      try {
+        if (i + 1 < order.size()) supernodes[reps[order[i + 1]]]->prefetch_sample();
+        query[order[i]] = supernodes[reps[order[i]]]->exhaustive_sample();
+
+      } catch (...) {
+        except = true;
+        err = std::current_exception();
+      }
     }
   }
   // Did one of our threads produce an exception?
   if (except) std::rethrow_exception(err);
 }
 
-inline std::vector<std::vector<node_id_t>> Graph::supernodes_to_merge(
-    std::pair<Edge, SampleSketchRet> *query, std::vector<node_id_t> &reps) {
-  std::vector<std::vector<node_id_t>> to_merge(num_nodes);
-  std::vector<node_id_t> new_reps;
-  for (auto i : reps) {
+inline void Graph::merge_edge_in_dsu(Edge edge) {
+  // query dsu
+  node_id_t a = get_parent(edge.src);
+  node_id_t b = get_parent(edge.dst);
+  if (a == b) return;
+
+#ifdef VERIFY_SAMPLES_F
+  verifier->verify_edge(edge);
+#endif
+
+  // make a the parent of b
+  if (size[a] < size[b]) std::swap(a,b);
+  parent[b] = a;
+  size[a] += size[b];
+
+  // b along with everything merged into it is merged into the final root of a
+  round_merged.push_back(b);
+  modified = true;
+
+  // Update spanning forest
+  auto src = std::min(edge.src, edge.dst);
+  auto dst = std::max(edge.src, edge.dst);
+  spanning_forest[src].insert(dst);
+}
+
+inline void Graph::next_round_reps(MergeLists &to_merge, std::vector<node_id_t> &reps) {
+  // group the merged representatives by their final root
+  round_pairs.clear();
+  for (node_id_t b : round_merged) round_pairs.emplace_back(get_parent(b), b);
+  std::sort(round_pairs.begin(), round_pairs.end());
+
+  to_merge.clear();
+  for (size_t i = 0; i < round_pairs.size(); i++) {
+    if (i == 0 || round_pairs[i].first != round_pairs[i - 1].first) {
+      to_merge.roots.push_back(round_pairs[i].first);
+      to_merge.offsets.push_back(i);
+    }
+    to_merge.children.push_back(round_pairs[i].second);
+  }
+  to_merge.offsets.push_back(round_pairs.size());
+
+  // keep the nodes whose sketch failed unless they did end up being able to merge
+  // after all. Merge the failed nodes and the roots so reps stays in increasing order.
+  std::sort(round_failed.begin(), round_failed.end());
+  reps.clear();
+  size_t r = 0;
+  for (node_id_t a : round_failed) {
+    while (r < to_merge.roots.size() && to_merge.roots[r] < a)
+      reps.push_back(to_merge.roots[r++]);
+    if (r < to_merge.roots.size() && to_merge.roots[r] == a) continue;
+    if (get_parent(a) == a) reps.push_back(a);
+  }
+  // add to reps all the nodes we will merge into
+  reps.insert(reps.end(), to_merge.roots.begin() + r, to_merge.roots.end());
+}
+
+inline void Graph::supernodes_to_merge(std::vector<std::pair<Edge, SampleSketchRet>> &query,
+                                       std::vector<node_id_t> &reps, MergeLists &to_merge) {
+  round_failed.clear();
+  round_merged.clear();
+  for (node_id_t r = 0; r < reps.size(); r++) {
     // unpack query result
-    Edge edge = query[i].first;
-    SampleSketchRet ret_code = query[i].second;
+    node_id_t i = reps[r];
+    Edge edge = query[r].first;
+    SampleSketchRet ret_code = query[r].second;
 
     // try this query again next round as it failed this round
     if (ret_code == FAIL) {
       modified = true;
-      new_reps.push_back(i);
+      round_failed.push_back(i);
       continue;
     }
     if (ret_code == ZERO) {
@@ -176,126 +328,268 @@ inline std::vector<std::vector<node_id_t>> Graph::supernodes_to_merge(
       continue;
     }
 
-    // query dsu
-    node_id_t a = get_parent(edge.src);
-    node_id_t b = get_parent(edge.dst);
-    if (a == b) continue;
+    merge_edge_in_dsu(edge);
+  }
+
+  next_round_reps(to_merge, reps);
+}
+
+inline void Graph::supernodes_to_merge(
+    std::vector<std::pair<std::unordered_set<Edge>, SampleSketchRet>> &query,
+    std::vector<node_id_t> &reps, MergeLists &to_merge) {
+  round_failed.clear();
+  round_merged.clear();
+  for (node_id_t r = 0; r < reps.size(); r++) {
+    node_id_t i = reps[r];
+    SampleSketchRet ret_code = query[r].second;
 
+    // try this query again next round as it failed this round
+    if (ret_code == FAIL) {
+      modified = true;
+      round_failed.push_back(i);
+      continue;
+    }
+    if (ret_code == ZERO) {
 #ifdef VERIFY_SAMPLES_F
-    verifier->verify_edge(edge);
+      verifier->verify_cc(i);
 #endif
+      continue;
+    }
 
-    // make a the parent of b
-    if (size[a] < size[b]) std::swap(a,b);
-    parent[b] = a;
-    size[a] += size[b];
+    // every sampled edge is in the cut of this supernode so merge on all of them
+    for (const Edge &edge : query[r].first)
+      merge_edge_in_dsu(edge);
+  }
 
-    // add b and any of the nodes to merge with it to a's vector
-    to_merge[a].push_back(b);
-    to_merge[a].insert(to_merge[a].end(), to_merge[b].begin(), to_merge[b].end());
-    to_merge[b].clear();
-    modified = true;
+  next_round_reps(to_merge, reps);
+}
 
-    // Update spanning forest
-    auto src = std::min(edge.src, edge.dst);
-    auto dst = std::max(edge.src, edge.dst);
-    spanning_forest[src].insert(dst);
+inline size_t Graph::backup_supernodes(std::vector<Supernode*> &copies,
+                                      const std::vector<node_id_t> &ids) {
+  if (!config._backup_in_mem) {
+    backup_to_disk(ids);
+    return ids.size() * Supernode::get_serialized_size();
   }
 
-  // remove nodes added to new_reps due to sketch failures that
-  // did end up being able to merge after all
-  std::vector<node_id_t> temp_vec;
-  for (node_id_t a : new_reps)
-    if (to_merge[a].empty()) temp_vec.push_back(a);
-  std::swap(new_reps, temp_vec);
-
-  // add to new_reps all the nodes we will merge into
-  for (node_id_t a = 0; a < num_nodes; a++)
-    if (!to_merge[a].empty()) new_reps.push_back(a);
+  bool except = false;
+  std::exception_ptr err;
+  copies.assign(ids.size(), nullptr);
+  #pragma omp parallel for default(shared)
+  for (node_id_t i = 0; i < ids.size(); i++) { // NOLINT(modernize-loop-convert)
+    try {
+      copies[i] = Supernode::makeSupernode(*supernodes[ids[i]]);
+    } catch (...) {
+      except = true;
+      err = std::current_exception();
+    }
+  }
 
-  reps = new_reps;
-  return to_merge;
+  // Did one of our threads produce an exception?
+  if (except) std::rethrow_exception(err);
+  return ids.size() * Supernode::get_size();
 }
 
-inline void Graph::merge_supernodes(Supernode** copy_supernodes, std::vector<node_id_t> &new_reps,
-               std::vector<std::vector<node_id_t>> &to_merge, bool make_copy) {
+namespace {
+// a range of the children of a merge list that is merged into a single target supernode
+struct MergeTask {
+  size_t beg;
+  size_t end;
+  Supernode** target; // the root itself or one of its partial supernodes
+};
+
+// the scratch supernodes holding partial merges of a root's large merge list
+struct PartialMerges {
+  node_id_t root;
+  std::vector<Supernode*> partials;
+};
+
+// merge lists shorter than this are never split
+constexpr size_t merge_chunk_min = 16;
+} // namespace
+
+inline size_t Graph::merge_supernodes(const MergeLists &to_merge) {
+  // A merge list longer than a thread's share of the work is split into chunks. The first
+  // chunk is merged into the root and the rest into scratch partial supernodes that are
+  // then XOR-reduced in a tree. This keeps every thread busy even when a single
+  // component absorbs most of the graph.
+  size_t num_threads = omp_get_max_threads();
+  size_t total = to_merge.children.size();
+  size_t share = std::max(merge_chunk_min, (total + num_threads - 1) / num_threads);
+
+  std::vector<PartialMerges> split;
+  std::vector<size_t> num_chunks(to_merge.num_lists(), 1);
+  for (size_t l = 0; l < to_merge.num_lists(); l++) {
+    size_t len = to_merge.offsets[l + 1] - to_merge.offsets[l];
+    if (num_threads > 1 && len > share) {
+      num_chunks[l] = (len + share - 1) / share;
+      split.push_back({to_merge.roots[l], std::vector<Supernode*>(num_chunks[l] - 1, nullptr)});
+    }
+  }
+
+  std::vector<MergeTask> tasks;
+  size_t s = 0;
+  for (size_t l = 0; l < to_merge.num_lists(); l++) {
+    size_t beg = to_merge.offsets[l];
+    size_t len = to_merge.offsets[l + 1] - beg;
+    for (size_t c = 0; c < num_chunks[l]; c++) {
+      Supernode** target = c == 0 ? &supernodes[to_merge.roots[l]] : &split[s].partials[c - 1];
+      tasks.push_back({beg + c * len / num_chunks[l], beg + (c + 1) * len / num_chunks[l], target});
+    }
+    if (num_chunks[l] > 1) ++s;
+  }
+
   bool except = false;
   std::exception_ptr err;
-  // loop over the to_merge vector and perform supernode merging
-  #pragma omp parallel for default(shared)
-  for (node_id_t i = 0; i < new_reps.size(); i++) { // NOLINT(modernize-loop-convert)
-    // OMP requires a traditional for-loop to work
-    node_id_t a = new_reps[i];
-    try {
-      if (make_copy && config._backup_in_mem) { // make a copy of a
-        copy_supernodes[a] = Supernode::makeSupernode(*supernodes[a]);
+  // perform merging of the nodes of each task into its target
+  #pragma omp parallel default(shared)
+  {
+    // nowait so the scope ends before the barrier and does not count the time spent in it
+    HwCounters::Scope hw_scope(hw_counters, MERGE_REGION);
+    #pragma omp for schedule(dynamic, 1) nowait
+    for (size_t t = 0; t < tasks.size(); t++) {
+      // OMP requires a traditional for-loop to work
+      const MergeTask &task = tasks[t];
+      try {
+        if (*task.target == nullptr) *task.target = Supernode::makeSupernode(num_nodes, seed);
+        for (size_t i = task.beg; i < task.end; i++) {
+          (*task.target)->merge(*supernodes[to_merge.children[i]]);
+        }
+      } catch (...) {
+        except = true;
+        err = std::current_exception();
       }
+    }
+  }
 
-      // perform merging of nodes b into node a
-      for (node_id_t b : to_merge[a]) {
-        supernodes[a]->merge(*supernodes[b]);
+  // reduce the partial supernodes of each root pairwise in a tree
+  size_t max_partials = 0;
+  for (auto &sp : split) max_partials = std::max(max_partials, sp.partials.size());
+  for (size_t stride = 1; stride < max_partials && !except; stride *= 2) {
+    std::vector<std::pair<Supernode*, Supernode*>> pairs;
+    for (auto &sp : split)
+      for (size_t i = 0; i + stride < sp.partials.size(); i += 2 * stride)
+        pairs.emplace_back(sp.partials[i], sp.partials[i + stride]);
+
+    #pragma omp parallel for default(shared)
+    for (size_t p = 0; p < pairs.size(); p++) {
+      try {
+        pairs[p].first->merge(*pairs[p].second);
+      } catch (...) {
+        except = true;
+        err = std::current_exception();
       }
+    }
+  }
+
+  // combine the reduced partials with their roots and free them
+  #pragma omp parallel for default(shared)
+  for (size_t p = 0; p < split.size(); p++) {
+    try {
+      if (!except) supernodes[split[p].root]->merge(*split[p].partials[0]);
     } catch (...) {
       except = true;
       err = std::current_exception();
     }
+    for (Supernode* partial : split[p].partials) free(partial);
   }
 
   // Did one of our threads produce an exception?
   if (except) std::rethrow_exception(err);
+  return split.size();
 }
 
-std::vector<std::set<node_id_t>> Graph::boruvka_emulation(bool make_copy) {
+void Graph::boruvka_emulation(bool make_copy) {
   printf("Total number of updates to sketches before CC %lu\n", num_updates.load()); // REMOVE this later
   update_locked = true; // disallow updating the graph after we run the alg
 
   cc_alg_start = std::chrono::steady_clock::now();
   bool first_round = true;
-  Supernode** copy_supernodes;
-  if (make_copy && config._backup_in_mem) 
-    copy_supernodes = new Supernode*[num_nodes];
-  std::pair<Edge, SampleSketchRet> *query = new std::pair<Edge, SampleSketchRet>[num_nodes];
-  std::vector<node_id_t> reps(num_nodes);
+  std::vector<node_id_t> reps;
   std::vector<node_id_t> backed_up;
-  std::fill(size, size + num_nodes, 1);
-  for (node_id_t i = 0; i < num_nodes; ++i) {
-    reps[i] = i;
-    if (make_copy && config._backup_in_mem) 
-      copy_supernodes[i] = nullptr;
+
+  // recompute only the dirty components if the rest of the dsu is still exact
+  if (dsu_valid && !dirty_nodes.empty()) {
+    reps = dirty_components();
+  } else {
+    reps.resize(num_nodes);
+    for (node_id_t i = 0; i < num_nodes; ++i) reps[i] = i;
+  }
+  dsu_valid = false; // the dsu is invalid until Boruvka completes
+
+  for (node_id_t i : reps) {
+    parent[i] = i;
+    size[i] = 1;
+    spanning_forest[i].clear();
   }
+  backup_copies.clear();
 
   // function to restore supernodes after CC if make_copy is specified
-  auto cleanup_copy = [&make_copy, this, &backed_up, &copy_supernodes]() {
+  auto cleanup_copy = [&make_copy, this, &backed_up]() {
     if (make_copy) {
+      auto restore_start = std::chrono::steady_clock::now();
       if(config._backup_in_mem) {
         // restore original supernodes and free memory
-        for (node_id_t i : backed_up) {
-          if (supernodes[i] != nullptr) free(supernodes[i]);
-          supernodes[i] = copy_supernodes[i];
+        for (size_t i = 0; i < backup_copies.size(); i++) {
+          if (backup_copies[i] == nullptr) continue; // backing up this supernode failed
+          free(supernodes[backed_up[i]]);
+          supernodes[backed_up[i]] = backup_copies[i];
         }
-        delete[] copy_supernodes;
+        backup_copies.clear();
       } else {
         restore_from_disk(backed_up);
+        query_stats.restore_bytes = backed_up.size() * Supernode::get_serialized_size();
       }
+      query_stats.restore_time = std::chrono::steady_clock::now() - restore_start;
     }
   };
 
-  for (node_id_t i = 0; i < num_nodes; ++i) {
-    parent[i] = i;
-    spanning_forest[i].clear();
-  }
+  query_stats.rounds.clear();
   try {
     do {
+      auto round_start = std::chrono::steady_clock::now();
+      BoruvkaRoundStats round;
+      round.num_reps = reps.size();
       modified = false;
-      sample_supernodes(query, reps);
-      std::vector<std::vector<node_id_t>> to_merge = supernodes_to_merge(query, reps);
+      if (config._exhaustive_boruvka) {
+        std::vector<std::pair<std::unordered_set<Edge>, SampleSketchRet>> ex_query(reps.size());
+        exhaustive_sample_supernodes(ex_query, reps);
+        auto dsu_start = std::chrono::steady_clock::now();
+        round.sample_time = dsu_start - round_start;
+        for (auto &res : ex_query) {
+          round.num_good += res.second == GOOD;
+          round.num_zero += res.second == ZERO;
+          round.num_fail += res.second == FAIL;
+        }
+        supernodes_to_merge(ex_query, reps, round_to_merge);
+        round.dsu_time = std::chrono::steady_clock::now() - dsu_start;
+      } else {
+        sample_supernodes(round_samples, reps);
+        auto dsu_start = std::chrono::steady_clock::now();
+        round.sample_time = dsu_start - round_start;
+        for (auto &res : round_samples) {
+          round.num_good += res.second == GOOD;
+          round.num_zero += res.second == ZERO;
+          round.num_fail += res.second == FAIL;
+        }
+        supernodes_to_merge(round_samples, reps, round_to_merge);
+        round.dsu_time = std::chrono::steady_clock::now() - dsu_start;
+      }
+      round.num_merges = round_to_merge.children.size();
+
       // make a copy if necessary
       if (make_copy && first_round) {
+        auto backup_start = std::chrono::steady_clock::now();
         backed_up = reps;
-        if (!config._backup_in_mem) backup_to_disk(backed_up);
+        query_stats.backup_bytes = backup_supernodes(backup_copies, backed_up);
+        round.backup_time = std::chrono::steady_clock::now() - backup_start;
       }
 
-      merge_supernodes(copy_supernodes, reps, to_merge, first_round && make_copy);
+      auto merge_start = std::chrono::steady_clock::now();
+      round.num_split = merge_supernodes(round_to_merge);
+      auto round_end = std::chrono::steady_clock::now();
+      round.merge_time = round_end - merge_start;
+      round.round_time = round_end - round_start;
+      query_stats.rounds.push_back(round);
 
 #ifdef VERIFY_SAMPLES_F
       if (!first_round && fail_round_2) throw OutOfQueriesException();
@@ -304,16 +598,25 @@ std::vector<std::set<node_id_t>> Graph::boruvka_emulation(bool make_copy) {
     } while (modified);
   } catch (...) {
     cleanup_copy();
-    delete[] query;
     std::rethrow_exception(std::current_exception());
   }
   cleanup_copy();
-  delete[] query;
+  dirty_nodes.clear();
   dsu_valid = true;
 
-  auto retval = cc_from_dsu();
+  cache_labels();
   cc_alg_end = std::chrono::steady_clock::now();
-  return retval;
+}
+
+std::vector<node_id_t> Graph::dirty_components() {
+  std::vector<bool> dirty_root(num_nodes, false);
+  for (node_id_t node : dirty_nodes)
+    dirty_root[get_parent(node)] = true;
+
+  std::vector<node_id_t> nodes;
+  for (node_id_t i = 0; i < num_nodes; ++i)
+    if (dirty_root[get_parent(i)]) nodes.push_back(i);
+  return nodes;
 }
 
 void Graph::backup_to_disk(const std::vector<node_id_t>& ids_to_backup) {
@@ -345,8 +648,26 @@ void Graph::restore_from_disk(const std::vector<node_id_t>& ids_to_restore) {
 }
 
 std::vector<std::set<node_id_t>> Graph::connected_components(bool cont) {
+  query_stats = QueryStats();
+
+  // no updates since the last query so return its result
+  if (cont && query_cache_valid()
+#ifdef VERIFY_SAMPLES_F
+      && !fail_round_2
+#endif // VERIFY_SAMPLES_F
+      ) {
+    cc_alg_start = flush_start = flush_end = std::chrono::steady_clock::now();
+    auto retval = cc_from_labels();
+#ifdef VERIFY_SAMPLES_F
+    verifier->verify_soln(retval);
+#endif
+    cc_alg_end = std::chrono::steady_clock::now();
+    finish_query_stats(CACHED);
+    return retval;
+  }
+
   // DSU check before calling force_flush()
-  if (dsu_valid && cont
+  if (dsu_exact() && cont
 #ifdef VERIFY_SAMPLES_F
       && !fail_round_2
 #endif // VERIFY_SAMPLES_F
@@ -364,6 +685,7 @@ std::vector<std::set<node_id_t>> Graph::connected_components(bool cont) {
     verifier->verify_soln(retval);
 #endif
     cc_alg_end = std::chrono::steady_clock::now();
+    finish_query_stats(EAGER_DSU);
     return retval;
   }
 
@@ -375,10 +697,12 @@ std::vector<std::set<node_id_t>> Graph::connected_components(bool cont) {
 
   std::vector<std::set<node_id_t>> ret;
   if (!cont) {
-    ret = boruvka_emulation(false); // merge in place
+    boruvka_emulation(false); // merge in place
+    ret = cc_from_labels();
 #ifdef VERIFY_SAMPLES_F
     verifier->verify_soln(ret);
 #endif
+    finish_query_stats(BORUVKA);
     return ret;
   }
   
@@ -386,7 +710,8 @@ std::vector<std::set<node_id_t>> Graph::connected_components(bool cont) {
   bool except = false;
   std::exception_ptr err;
   try {
-    ret = boruvka_emulation(true);
+    boruvka_emulation(true);
+    ret = cc_from_labels();
 #ifdef VERIFY_SAMPLES_F
     verifier->verify_soln(ret);
 #endif
@@ -406,23 +731,55 @@ std::vector<std::set<node_id_t>> Graph::connected_components(bool cont) {
   // check if boruvka errored
   if (except) std::rethrow_exception(err);
 
+  finish_query_stats(BORUVKA);
   return ret;
 }
 
 std::vector<std::set<node_id_t>> Graph::cc_from_dsu() {
-  // calculate connected components using DSU structure
-  std::map<node_id_t, std::set<node_id_t>> temp;
+  cache_labels();
+  return cc_from_labels();
+}
+
+void Graph::cache_labels() {
+  cc_labels.resize(num_nodes);
+  #pragma omp parallel for default(shared)
   for (node_id_t i = 0; i < num_nodes; ++i)
-    temp[get_parent(i)].insert(i);
+    cc_labels[i] = get_root(i);
+  cache_epoch = update_epoch.load();
+}
+
+std::vector<std::set<node_id_t>> Graph::cc_from_labels() {
+  // number the components in order of their smallest node. Unlike the roots this
+  // order does not depend upon the merges performed to build the dsu.
+  constexpr node_id_t no_idx = -1;
+  std::vector<node_id_t> cc_idx(num_nodes, no_idx);
   std::vector<std::set<node_id_t>> retval;
-  retval.reserve(temp.size());
-  for (const auto& it : temp) retval.push_back(it.second);
+  for (node_id_t i = 0; i < num_nodes; ++i) {
+    node_id_t &idx = cc_idx[cc_labels[i]];
+    if (idx == no_idx) {
+      idx = retval.size();
+      retval.emplace_back();
+    }
+    // nodes are inserted in increasing order so hinting at end() makes this linear
+    retval[idx].insert(retval[idx].end(), i);
+  }
   return retval;
 }
 
 bool Graph::point_query(node_id_t a, node_id_t b) {
+  query_stats = QueryStats();
+
+  // no updates since the last query so answer from its labels
+  if (query_cache_valid()) {
+    cc_alg_start = flush_start = flush_end = std::chrono::steady_clock::now();
+    bool retval = (cc_labels[a] == cc_labels[b]);
+    cc_alg_end = std::chrono::steady_clock::now();
+    finish_query_stats(CACHED);
+    return retval;
+  }
+
   // DSU check before calling force_flush()
-  if (dsu_valid) {
+  if (dsu_exact()) {
     cc_alg_start = flush_start = flush_end = std::chrono::steady_clock::now();
 #ifdef VERIFY_SAMPLES_F
     for (node_id_t src = 0; src < num_nodes; ++src) {
@@ -433,6 +790,7 @@ bool Graph::point_query(node_id_t a, node_id_t b) {
 #endif
     bool retval = (get_parent(a) == get_parent(b));
     cc_alg_end = std::chrono::steady_clock::now();
+    finish_query_stats(EAGER_DSU);
     return retval;
   }
 
@@ -449,18 +807,16 @@ bool Graph::point_query(node_id_t a, node_id_t b) {
   bool ret;
   try {
     boruvka_emulation(true);
-    ret = (get_parent(a) == get_parent(b));
+    ret = (cc_labels[a] == cc_labels[b]);
   } catch (...) {
     except = true;
     err = std::current_exception();
   }
 
   // get ready for ingesting more from the stream
-  // reset dsu and resume graph workers
+  // the dsu remains valid so later queries need not rerun Boruvka
   for (node_id_t i = 0; i < num_nodes; i++) {
     supernodes[i]->reset_query_state();
-    parent[i] = i;
-    size[i] = 1;
   }
   update_locked = false;
   GraphWorker::unpause_workers();
@@ -468,9 +824,88 @@ bool Graph::point_query(node_id_t a, node_id_t b) {
   // check if boruvka errored
   if (except) std::rethrow_exception(err);
 
+  finish_query_stats(BORUVKA);
   return ret;
 }
 
+std::vector<bool> Graph::point_queries(const std::vector<std::pair<node_id_t, node_id_t>> &pairs) {
+  query_stats = QueryStats();
+  QueryPath path = BORUVKA;
+
+  // no updates since the last query so answer from its labels
+  if (query_cache_valid()) {
+    cc_alg_start = flush_start = flush_end = std::chrono::steady_clock::now();
+    path = CACHED;
+  }
+  // DSU check before calling force_flush()
+  else if (dsu_exact()) {
+    path = EAGER_DSU;
+    cc_alg_start = flush_start = flush_end = std::chrono::steady_clock::now();
+#ifdef VERIFY_SAMPLES_F
+    for (node_id_t src = 0; src < num_nodes; ++src) {
+      for (const auto& dst : spanning_forest[src]) {
+        verifier->verify_edge({src, dst});
+      }
+    }
+#endif
+  } else {
+    flush_start = std::chrono::steady_clock::now();
+    gts->force_flush(); // flush everything in guttering system to make final updates
+    GraphWorker::pause_workers(); // wait for the workers to finish applying the updates
+    flush_end = std::chrono::steady_clock::now();
+    // after this point all updates have been processed from the buffer tree
+
+    // if backing up in memory then perform copying in boruvka
+    bool except = false;
+    std::exception_ptr err;
+    try {
+      boruvka_emulation(true);
+    } catch (...) {
+      except = true;
+      err = std::current_exception();
+    }
+
+    // get ready for ingesting more from the stream
+    // the dsu remains valid so later queries need not rerun Boruvka
+    for (node_id_t i = 0; i < num_nodes; i++) {
+      supernodes[i]->reset_query_state();
+    }
+    update_locked = false;
+    GraphWorker::unpause_workers();
+
+    // check if boruvka errored
+    if (except) std::rethrow_exception(err);
+  }
+
+  // answer the queries against the labels or the dsu. get_root() does not modify
+  // the dsu so every query can be answered concurrently.
+  bool use_labels = query_cache_valid();
+  // a vector of char rather than bool so that threads can write neighbouring answers
+  std::vector<char> answers(pairs.size());
+  #pragma omp parallel for default(none) shared(pairs, answers, use_labels)
+  for (size_t i = 0; i < pairs.size(); i++) {
+    if (use_labels)
+      answers[i] = cc_labels[pairs[i].first] == cc_labels[pairs[i].second];
+    else
+      answers[i] = get_root(pairs[i].first) == get_root(pairs[i].second);
+  }
+  std::vector<bool> retval(answers.begin(), answers.end());
+  cc_alg_end = std::chrono::steady_clock::now();
+  finish_query_stats(path);
+  return retval;
+}
+
+void Graph::finish_query_stats(QueryPath path) {
+  query_stats.path = path;
+  query_stats.flush_time = flush_end - flush_start;
+  query_stats.alg_time = cc_alg_end - cc_alg_start;
+}
+
+node_id_t Graph::get_root(node_id_t node) const {
+  while (parent[node] != node) node = parent[node];
+  return node;
+}
+
 node_id_t Graph::get_parent(node_id_t node) {
   if (parent[node] == node) return node;
   return parent[node] = get_parent(parent[node]);
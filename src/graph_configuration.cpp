@@ -37,6 +37,16 @@ GraphConfiguration& GraphConfiguration::group_size(size_t group_size) {
   return *this;
 }
 
+GraphConfiguration& GraphConfiguration::exhaustive_boruvka(bool exhaustive_boruvka) {
+  _exhaustive_boruvka = exhaustive_boruvka;
+  return *this;
+}
+
+GraphConfiguration& GraphConfiguration::hw_counters(bool hw_counters) {
+  _hw_counters = hw_counters;
+  return *this;
+}
+
 GutteringConfiguration& GraphConfiguration::gutter_conf() {
   return _gutter_conf;
 }
@@ -53,6 +63,8 @@ std::ostream& operator<< (std::ostream &out, const GraphConfiguration &conf) {
     out << " Size of groups        = " << conf._group_size << std::endl;
     out << " On disk data location = " << conf._disk_dir << std::endl;
     out << " Backup sketch to RAM  = " << (conf._backup_in_mem? "ON" : "OFF") << std::endl;
+    out << " Exhaustive Boruvka    = " << (conf._exhaustive_boruvka? "ON" : "OFF") << std::endl;
+    out << " Hardware counters     = " << (conf._hw_counters? "ON" : "OFF") << std::endl;
     out << conf._gutter_conf;
     return out;
   }
\ No newline at end of file
@@ -16,6 +16,8 @@ long GraphWorker::supernode_size;
 GraphWorker **GraphWorker::workers;
 std::condition_variable GraphWorker::pause_condition;
 std::mutex GraphWorker::pause_lock;
+WorkerBatchStats GraphWorker::batch_stats;
+std::mutex GraphWorker::batch_stats_lock;
 
 /***********************************************
  ******** GraphWorker Static Functions *********
@@ -27,6 +29,10 @@ void GraphWorker::start_workers(Graph *_graph, GutteringSystem *_gts, long _supe
   shutdown = false;
   paused   = false;
   supernode_size = _supernode_size;
+  {
+    std::lock_guard<std::mutex> lk(batch_stats_lock);
+    batch_stats = WorkerBatchStats();
+  }
 
   workers = (GraphWorker **) calloc(num_groups, sizeof(GraphWorker *));
   for (int i = 0; i < num_groups; i++) {
@@ -42,6 +48,10 @@ void GraphWorker::stop_workers() {
   workers[0]->gts->set_non_block(true); // make the GraphWorkers bypass waiting in queue
   
   pause_condition.notify_all();      // tell any paused threads to continue and exit
+  for (int i = 0; i < num_groups; i++) {
+    workers[i]->thr.join();
+  }
+  aggregate_batch_stats();
   for (int i = 0; i < num_groups; i++) {
     delete workers[i];
   }
@@ -72,8 +82,9 @@ void GraphWorker::pause_workers() {
     }
     lk.unlock();
 
-    if (all_paused) return; // all workers are done so exit
+    if (all_paused) break; // all workers are done so exit
   }
+  aggregate_batch_stats();
 }
 
 void GraphWorker::unpause_workers() {
@@ -105,6 +116,40 @@ void GraphWorker::unpause_workers() {
   }
 }
 
+WorkerMetrics GraphWorkerStats::metrics() const {
+  WorkerMetrics m;
+  m.batches        = batches.load(std::memory_order_relaxed);
+  m.updates        = updates.load(std::memory_order_relaxed);
+  m.wait_time      = wait_ns.load(std::memory_order_relaxed) / 1e9;
+  m.delta_time     = delta_ns.load(std::memory_order_relaxed) / 1e9;
+  m.apply_time     = apply_ns.load(std::memory_order_relaxed) / 1e9;
+  m.lock_wait_time = lock_wait_ns.load(std::memory_order_relaxed) / 1e9;
+  m.waiting        = waiting.load(std::memory_order_relaxed);
+  return m;
+}
+
+void GraphWorker::aggregate_batch_stats() {
+  WorkerBatchStats stats;
+  for (int i = 0; i < num_groups; i++) {
+    stats.worker_batch_sizes.push_back(workers[i]->batch_sizes);
+    stats.batch_sizes.merge(workers[i]->batch_sizes);
+    stats.hot_nodes.merge(workers[i]->hot_nodes);
+  }
+  std::lock_guard<std::mutex> lk(batch_stats_lock);
+  batch_stats = std::move(stats);
+}
+
+WorkerBatchStats GraphWorker::get_batch_stats() {
+  std::lock_guard<std::mutex> lk(batch_stats_lock);
+  return batch_stats;
+}
+
+std::vector<WorkerMetrics> GraphWorker::get_metrics() {
+  std::vector<WorkerMetrics> metrics;
+  for (int i = 0; i < num_groups; i++) metrics.push_back(workers[i]->stats.metrics());
+  return metrics;
+}
+
 /***********************************************
  ************** GraphWorker class **************
  ***********************************************/
@@ -115,22 +160,30 @@ GraphWorker::GraphWorker(int _id, Graph *_graph, GutteringSystem *_gts) :
 
 GraphWorker::~GraphWorker() {
   // join the GraphWorker thread to reclaim resources
-  thr.join();
+  if (thr.joinable()) thr.join();
   free(delta_node);
 }
 
 void GraphWorker::do_work() {
   WorkQueue::DataNode *data;
+  graph->hw_counters.name_thread("worker " + std::to_string(id));
   while(true) {
     // call get_data which will handle waiting on the queue
     // and will enforce locking.
+    auto wait_start = std::chrono::steady_clock::now();
+    stats.set_waiting(true);
     bool valid = gts->get_data(data);
+    stats.set_waiting(false);
+    stats.record_wait(std::chrono::steady_clock::now() - wait_start);
 
     if (valid) {
       const std::vector<update_batch> &batches = data->get_batches();
       for (auto &batch : batches) {
-        if (batch.upd_vec.size() > 0)
-          graph->batch_update(batch.node_idx, batch.upd_vec, delta_node);
+        if (batch.upd_vec.size() > 0) {
+          batch_sizes.record(batch.upd_vec.size());
+          hot_nodes.record(batch.node_idx, batch.upd_vec.size());
+          graph->batch_update(batch.node_idx, batch.upd_vec, delta_node, &stats);
+        }
       }
       gts->get_data_callback(data); // inform guttering system that we're done
     }
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/hw_counters.h"
+
+namespace {
+
+struct HwEventDesc {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+const HwEventDesc event_descs[NUM_HW_EVENTS] = {
+  {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+  {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {"llc_misses",    PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_LL,
+                    PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  {"dtlb_misses",   PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB,
+                    PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+  {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+const char *region_names[NUM_HW_REGIONS] = {"delta", "apply", "sample", "merge"};
+
+std::atomic<uint64_t> next_instance_id(0);
+
+// the counters of the calling thread and the HwCounters instance they belong to
+thread_local uint64_t local_instance_id = -1;
+thread_local void *local_counters = nullptr;
+
+} // namespace
+
+HwCounts& HwCounts::operator+=(const HwCounts &oth) {
+  calls += oth.calls;
+  for (int e = 0; e < NUM_HW_EVENTS; e++) events[e] += oth.events[e];
+  return *this;
+}
+
+struct HwCounters::ThreadCounters {
+  std::mutex mtx; // protects counts from concurrent calls to stats() and reset()
+  HwThreadCounts counts;
+  bool opened = false;
+  int leader = -1;
+  int num_open = 0;
+  int slot[NUM_HW_EVENTS]; // position of each event within the group, or -1
+
+  ~ThreadCounters() {
+    if (leader != -1) close(leader);
+    for (int fd : fds) close(fd);
+  }
+
+  // open a group of counters upon the calling thread
+  void open() {
+    opened = true;
+    for (int e = 0; e < NUM_HW_EVENTS; e++) {
+      slot[e] = -1;
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = event_descs[e].type;
+      attr.config         = event_descs[e].config;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING;
+      int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+      if (fd == -1) continue;
+      if (leader == -1) leader = fd;
+      else fds.push_back(fd);
+      slot[e] = num_open++;
+    }
+  }
+
+  // read the value of each event followed by the times enabled and running
+  void read_values(uint64_t *values) {
+    uint64_t buf[3 + NUM_HW_EVENTS] = {};
+    if (leader == -1 || read(leader, buf, sizeof(buf)) <= 0) {
+      memset(values, 0, sizeof(uint64_t) * (NUM_HW_EVENTS + 2));
+      return;
+    }
+    // buf holds the number of events, the times enabled and running, then the values
+    for (int e = 0; e < NUM_HW_EVENTS; e++)
+      values[e] = slot[e] == -1 ? 0 : buf[3 + slot[e]];
+    values[NUM_HW_EVENTS]     = buf[1];
+    values[NUM_HW_EVENTS + 1] = buf[2];
+  }
+
+private:
+  std::vector<int> fds; // the group members other than the leader
+};
+
+HwCounters::HwCounters(bool enabled) : enabled(enabled), instance_id(next_instance_id++) {}
+
+HwCounters::~HwCounters() = default;
+
+HwCounters::ThreadCounters *HwCounters::local() {
+  if (local_instance_id == instance_id)
+    return static_cast<ThreadCounters *>(local_counters);
+
+  std::lock_guard<std::mutex> lk(threads_mtx);
+  threads.emplace_back(new ThreadCounters());
+  local_instance_id = instance_id;
+  local_counters = threads.back().get();
+  return threads.back().get();
+}
+
+void HwCounters::name_thread(const std::string &name) {
+  if (!enabled) return;
+  ThreadCounters *thr = local();
+  std::lock_guard<std::mutex> lk(thr->mtx);
+  thr->counts.name = name;
+}
+
+HwCounterStats HwCounters::stats() {
+  HwCounterStats stats;
+  stats.enabled = enabled;
+  std::fill(stats.supported, stats.supported + NUM_HW_EVENTS, true);
+  std::lock_guard<std::mutex> lk(threads_mtx);
+  for (auto &thr : threads) {
+    std::lock_guard<std::mutex> thr_lk(thr->mtx);
+    if (!thr->opened) continue; // named but never measured a region
+    stats.threads.push_back(thr->counts);
+    for (int e = 0; e < NUM_HW_EVENTS; e++) stats.supported[e] &= thr->slot[e] != -1;
+  }
+  if (stats.threads.empty())
+    std::fill(stats.supported, stats.supported + NUM_HW_EVENTS, false);
+  return stats;
+}
+
+void HwCounters::reset() {
+  std::lock_guard<std::mutex> lk(threads_mtx);
+  for (auto &thr : threads) {
+    std::lock_guard<std::mutex> thr_lk(thr->mtx);
+    for (auto &region : thr->counts.regions) region = HwCounts();
+  }
+}
+
+void HwCounters::Scope::begin() {
+  if (!thr->opened) thr->open();
+  thr->read_values(start);
+}
+
+void HwCounters::Scope::end() {
+  uint64_t stop[NUM_HW_EVENTS + 2];
+  thr->read_values(stop);
+  uint64_t enabled = stop[NUM_HW_EVENTS] - start[NUM_HW_EVENTS];
+  uint64_t running = stop[NUM_HW_EVENTS + 1] - start[NUM_HW_EVENTS + 1];
+  // scale up the counts if the group was only scheduled upon the pmu part of the time
+  double scale = running > 0 && running < enabled ? (double) enabled / running : 1;
+
+  std::lock_guard<std::mutex> lk(thr->mtx);
+  HwCounts &counts = thr->counts.regions[region];
+  counts.calls++;
+  for (int e = 0; e < NUM_HW_EVENTS; e++)
+    counts.events[e] += (uint64_t) ((stop[e] - start[e]) * scale);
+}
+
+HwCounts HwCounterStats::total(HwRegion region) const {
+  HwCounts sum;
+  for (auto &thr : threads) sum += thr.regions[region];
+  return sum;
+}
+
+std::ostream& operator<< (std::ostream &out, const HwCounterStats &stats) {
+  out << "Hardware Counters:" << std::endl;
+  if (!stats.enabled) {
+    out << " Disabled" << std::endl;
+    return out;
+  }
+  out << " Unsupported events    =";
+  bool any_unsupported = false;
+  for (int e = 0; e < NUM_HW_EVENTS; e++) {
+    if (!stats.supported[e]) {
+      out << " " << event_descs[e].name;
+      any_unsupported = true;
+    }
+  }
+  out << (any_unsupported ? "" : " none") << std::endl;
+
+  auto print_counts = [&](const std::string &name, HwRegion r, const HwCounts &counts) {
+    if (counts.calls == 0) return;
+    out << "  " << std::left << std::setw(10) << name << std::setw(7) << region_names[r]
+        << std::right << " calls=" << counts.calls;
+    for (int e = 0; e < NUM_HW_EVENTS; e++)
+      if (stats.supported[e]) out << " " << event_descs[e].name << "=" << counts.events[e];
+    if (stats.supported[HW_CYCLES] && stats.supported[HW_INSTRUCTIONS] &&
+        counts.events[HW_CYCLES] > 0)
+      out << " ipc=" << (double) counts.events[HW_INSTRUCTIONS] / counts.events[HW_CYCLES];
+    out << std::endl;
+  };
+
+  for (int r = 0; r < NUM_HW_REGIONS; r++)
+    print_counts("total", (HwRegion) r, stats.total((HwRegion) r));
+  for (size_t t = 0; t < stats.threads.size(); t++) {
+    const HwThreadCounts &thr = stats.threads[t];
+    std::string name = thr.name.empty() ? "thread " + std::to_string(t) : thr.name;
+    for (int r = 0; r < NUM_HW_REGIONS; r++) print_counts(name, (HwRegion) r, thr.regions[r]);
+  }
+  return out;
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <string>
+
+#include "../include/ingest_metrics.h"
+
+void IngestMetrics::write_json(std::ostream &out) const {
+  out << "{\"uptime\":" << uptime << ",\"updates_inserted\":" << updates_inserted
+      << ",\"updates_applied\":" << updates_applied << ",\"gutter_backlog\":" << gutter_backlog()
+      << ",\"workers_waiting\":" << workers_waiting << ",\"workers\":[";
+  for (size_t i = 0; i < workers.size(); i++) {
+    const WorkerMetrics &w = workers[i];
+    out << (i == 0 ? "" : ",") << "{\"batches\":" << w.batches << ",\"updates\":" << w.updates
+        << ",\"avg_batch_size\":" << w.avg_batch_size() << ",\"wait_sec\":" << w.wait_time
+        << ",\"delta_sec\":" << w.delta_time << ",\"apply_sec\":" << w.apply_time
+        << ",\"lock_wait_sec\":" << w.lock_wait_time
+        << ",\"waiting\":" << (w.waiting ? "true" : "false") << "}";
+  }
+  out << "]}" << std::endl;
+}
+
+void IngestMetrics::write_prometheus(std::ostream &out) const {
+  auto metric = [&](const std::string &name, const std::string &type, const std::string &help) {
+    out << "# HELP graphzeppelin_" << name << " " << help << "\n";
+    out << "# TYPE graphzeppelin_" << name << " " << type << "\n";
+  };
+  metric("uptime_seconds", "gauge", "Seconds since the graph was created.");
+  out << "graphzeppelin_uptime_seconds " << uptime << "\n";
+  metric("updates_inserted_total", "counter", "Updates inserted into the guttering system.");
+  out << "graphzeppelin_updates_inserted_total " << updates_inserted << "\n";
+  metric("updates_applied_total", "counter", "Updates applied to the sketches.");
+  out << "graphzeppelin_updates_applied_total " << updates_applied << "\n";
+  metric("gutter_backlog_updates", "gauge", "Updates buffered in the guttering system.");
+  out << "graphzeppelin_gutter_backlog_updates " << gutter_backlog() << "\n";
+  metric("workers_waiting", "gauge", "Graph workers waiting for a batch.");
+  out << "graphzeppelin_workers_waiting " << workers_waiting << "\n";
+
+  // one labelled sample per worker of each worker metric
+  auto per_worker = [&](const std::string &name, const std::string &type,
+                        const std::string &help, double (*value)(const WorkerMetrics &)) {
+    metric(name, type, help);
+    for (size_t i = 0; i < workers.size(); i++)
+      out << "graphzeppelin_" << name << "{worker=\"" << i << "\"} " << value(workers[i]) << "\n";
+  };
+  per_worker("worker_batches_total", "counter", "Batches applied by the worker.",
+             [](const WorkerMetrics &w) { return (double) w.batches; });
+  per_worker("worker_updates_total", "counter", "Updates applied by the worker.",
+             [](const WorkerMetrics &w) { return (double) w.updates; });
+  per_worker("worker_avg_batch_size", "gauge", "Average updates per batch.",
+             [](const WorkerMetrics &w) { return w.avg_batch_size(); });
+  per_worker("worker_wait_seconds_total", "counter", "Seconds blocked waiting for a batch.",
+             [](const WorkerMetrics &w) { return w.wait_time; });
+  per_worker("worker_delta_seconds_total", "counter", "Seconds generating delta supernodes.",
+             [](const WorkerMetrics &w) { return w.delta_time; });
+  per_worker("worker_apply_seconds_total", "counter", "Seconds applying delta supernodes.",
+             [](const WorkerMetrics &w) { return w.apply_time; });
+  per_worker("worker_lock_wait_seconds_total", "counter", "Seconds waiting for supernode locks.",
+             [](const WorkerMetrics &w) { return w.lock_wait_time; });
+  out.flush();
+}
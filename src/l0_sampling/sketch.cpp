@@ -3,6 +3,11 @@
 #include <cstring>
 #include <iostream>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SKETCH_HAS_AVX2_KERNEL
+#endif
+
 vec_t Sketch::failure_factor = 100;
 vec_t Sketch::n;
 size_t Sketch::num_elems;
@@ -93,6 +98,98 @@ void Sketch::batch_update(const std::vector<vec_t>& updates) {
   }
 }
 
+/*
+ * The vectorized kernel reimplements the hash computed by Bucket_Boruvka::get_index_hash()
+ * which is XXH3_64bits_withSeed() of an 8 byte input. For 8 bytes XXH3 (v0.8) reduces to
+ * a byte swap, an xor with a seed dependent constant and the rrmxmx mixer.
+ */
+namespace {
+// the two words of the XXH3 default secret read when hashing 8 bytes
+constexpr uint64_t xxh3_secret_8  = 0x1cad21f72c81017cULL;
+constexpr uint64_t xxh3_secret_16 = 0xdb979083e96dd4deULL;
+constexpr uint64_t xxh3_prime_mx2 = 0x9FB21C651E98DF25ULL;
+
+inline uint64_t xxh3_bitflip(uint64_t seed) {
+  seed ^= uint64_t(__builtin_bswap32(uint32_t(seed))) << 32;
+  return (xxh3_secret_8 ^ xxh3_secret_16) - seed;
+}
+
+#ifdef SKETCH_HAS_AVX2_KERNEL
+// low 64 bits of the product of each pair of 64 bit lanes
+__attribute__((target("avx2")))
+inline __m256i mul64_avx2(__m256i x, __m256i y) {
+  __m256i lo    = _mm256_mul_epu32(x, y);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+                                   _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+inline __m256i rotl64_avx2(__m256i x, int r) {
+  return _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - r));
+}
+#endif // SKETCH_HAS_AVX2_KERNEL
+} // namespace
+
+size_t Sketch::first_good_bucket_scalar(const vec_t* a, const vec_hash_t* c, size_t num,
+                                        uint64_t seed) {
+  for (size_t i = 0; i < num; ++i) {
+    if (Bucket_Boruvka::is_good(a[i], c[i], seed))
+      return i;
+  }
+  return num;
+}
+
+#ifdef SKETCH_HAS_AVX2_KERNEL
+__attribute__((target("avx2")))
+size_t Sketch::first_good_bucket_avx2(const vec_t* a, const vec_hash_t* c, size_t num,
+                                      uint64_t seed) {
+  const __m256i bitflip = _mm256_set1_epi64x(xxh3_bitflip(seed));
+  const __m256i prime   = _mm256_set1_epi64x(xxh3_prime_mx2);
+  const __m256i len     = _mm256_set1_epi64x(sizeof(vec_t));
+  const __m256i low32   = _mm256_set1_epi64x(0xFFFFFFFF);
+
+  size_t i = 0;
+  for (; i + 4 <= num; i += 4) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vc = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i)));
+
+    // empty buckets are common in sparse sketches and can never be good
+    __m256i either = _mm256_or_si256(va, vc);
+    if (_mm256_testz_si256(either, either)) continue;
+
+    // swap the 32 bit halves of a and mix with rrmxmx
+    __m256i h = _mm256_xor_si256(_mm256_shuffle_epi32(va, 0xB1), bitflip);
+    h = _mm256_xor_si256(h, _mm256_xor_si256(rotl64_avx2(h, 49), rotl64_avx2(h, 24)));
+    h = mul64_avx2(h, prime);
+    h = _mm256_xor_si256(h, _mm256_add_epi64(_mm256_srli_epi64(h, 35), len));
+    h = mul64_avx2(h, prime);
+    h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 28));
+
+    // the checksum is the low 32 bits of the hash
+    __m256i good = _mm256_cmpeq_epi64(_mm256_and_si256(h, low32), vc);
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(good));
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+  return i + first_good_bucket_scalar(a + i, c + i, num - i, seed);
+}
+
+// choose the kernel once based upon the features of this cpu
+size_t (*const Sketch::first_good_bucket)(const vec_t*, const vec_hash_t*, size_t, uint64_t) =
+  []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? first_good_bucket_avx2 : first_good_bucket_scalar;
+  }();
+#else
+size_t Sketch::first_good_bucket_avx2(const vec_t* a, const vec_hash_t* c, size_t num,
+                                      uint64_t seed) {
+  return first_good_bucket_scalar(a, c, num, seed);
+}
+
+size_t (*const Sketch::first_good_bucket)(const vec_t*, const vec_hash_t*, size_t, uint64_t) =
+  Sketch::first_good_bucket_scalar;
+#endif // SKETCH_HAS_AVX2_KERNEL
+
 std::pair<vec_t, SampleSketchRet> Sketch::query() {
   if (already_queried) {
     throw MultipleQueryException();
@@ -105,13 +202,11 @@ std::pair<vec_t, SampleSketchRet> Sketch::query() {
   if (Bucket_Boruvka::is_good(bucket_a[num_elems - 1], bucket_c[num_elems - 1], checksum_seed()))
     return {bucket_a[num_elems - 1], GOOD};
 
-  for (unsigned i = 0; i < num_columns; ++i) {
-    for (unsigned j = 0; j < num_guesses; ++j) {
-      unsigned bucket_id = i * num_guesses + j;
-      if (Bucket_Boruvka::is_good(bucket_a[bucket_id], bucket_c[bucket_id], checksum_seed()))
-        return {bucket_a[bucket_id], GOOD};
-    }
-  }
+  // the buckets of each column are contiguous so search them all in order
+  size_t num_buckets = num_columns * num_guesses;
+  size_t bucket_id = first_good_bucket(bucket_a, bucket_c, num_buckets, checksum_seed());
+  if (bucket_id < num_buckets)
+    return {bucket_a[bucket_id], GOOD};
   return {0, FAIL};
 }
 
@@ -128,14 +223,13 @@ std::pair<std::unordered_set<vec_t>, SampleSketchRet> Sketch::exhaustive_query()
     ret.insert(bucket_a[num_elems - 1]);
     return {ret, GOOD};
   }
-  for (unsigned i = 0; i < num_columns; ++i) {
-    for (unsigned j = 0; j < num_guesses; ++j) {
-      unsigned bucket_id = i * num_guesses + j;
-      unlikely_if (
-      Bucket_Boruvka::is_good(bucket_a[bucket_id], bucket_c[bucket_id], checksum_seed())) {
-        ret.insert(bucket_a[bucket_id]);
-      }
-    }
+  // resume the search after each good bucket until every bucket has been checked
+  size_t num_buckets = num_columns * num_guesses;
+  size_t bucket_id = first_good_bucket(bucket_a, bucket_c, num_buckets, checksum_seed());
+  while (bucket_id < num_buckets) {
+    ret.insert(bucket_a[bucket_id]);
+    bucket_id += 1 + first_good_bucket(bucket_a + bucket_id + 1, bucket_c + bucket_id + 1,
+                                       num_buckets - bucket_id - 1, checksum_seed());
   }
   already_queried = true;
 
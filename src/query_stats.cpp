@@ -0,0 +1,30 @@
+#include <iostream>
+
+#include "../include/query_stats.h"
+
+std::ostream& operator<< (std::ostream &out, const QueryStats &stats) {
+  std::string path = "Cached labels";
+  if (stats.path == EAGER_DSU)
+    path = "Eager DSU";
+  else if (stats.path == BORUVKA)
+    path = "Boruvka";
+  out << "Query Statistics:" << std::endl;
+  out << " Answered by           = " << path << std::endl;
+  out << " Flush time(sec)       = " << stats.flush_time.count() << std::endl;
+  out << " Algorithm time(sec)   = " << stats.alg_time.count() << std::endl;
+  out << " Restore time(sec)     = " << stats.restore_time.count() << std::endl;
+  out << " Backup bytes          = " << stats.backup_bytes << std::endl;
+  out << " Restore bytes         = " << stats.restore_bytes << std::endl;
+  out << " Boruvka rounds        = " << stats.rounds.size() << std::endl;
+  for (size_t r = 0; r < stats.rounds.size(); r++) {
+    const BoruvkaRoundStats &round = stats.rounds[r];
+    out << "  Round " << r << ": reps=" << round.num_reps
+        << " good=" << round.num_good << " zero=" << round.num_zero
+        << " fail=" << round.num_fail << " merges=" << round.num_merges
+        << " split=" << round.num_split << std::endl;
+    out << "   sample=" << round.sample_time.count() << "s dsu=" << round.dsu_time.count()
+        << "s backup=" << round.backup_time.count() << "s merge=" << round.merge_time.count()
+        << "s total=" << round.round_time.count() << "s" << std::endl;
+  }
+  return out;
+}
@@ -127,12 +127,20 @@ void Supernode::update(vec_t upd) {
     get_sketch(i)->update(upd);
 }
 
-void Supernode::apply_delta_update(const Supernode* delta_node) {
-  std::unique_lock<std::mutex> lk(node_mt);
+std::chrono::nanoseconds Supernode::apply_delta_update(const Supernode* delta_node) {
+  // only time the lock if it is contended
+  std::chrono::nanoseconds lock_wait(0);
+  std::unique_lock<std::mutex> lk(node_mt, std::try_to_lock);
+  if (!lk.owns_lock()) {
+    auto start = std::chrono::steady_clock::now();
+    lk.lock();
+    lock_wait = std::chrono::steady_clock::now() - start;
+  }
   for (size_t i = 0; i < num_sketches; ++i) {
     *get_sketch(i) += *delta_node->get_sketch(i);
   }
   lk.unlock();
+  return lock_wait;
 }
 
 /*
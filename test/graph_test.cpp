@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 #include "../include/graph.h"
 #include "../graph_worker.h"
@@ -7,6 +8,8 @@
 #include "../include/test/mat_graph_verifier.h"
 #include "../include/test/graph_gen.h"
 #include <binary_graph_stream.h>
+#include <dsu.h>
+#include <omp.h>
 
 /**
  * For many of these tests (especially for those upon very sparse and small graphs)
@@ -222,6 +225,35 @@ TEST_P(GraphTest, MultipleWorkers) {
   } 
 }
 
+// Test the variant of Boruvka that merges upon every edge returned by
+// an exhaustive query of each supernode's sketch
+TEST_P(GraphTest, ExhaustiveBoruvka) {
+  auto config = GraphConfiguration()
+                .gutter_sys(GetParam())
+                .exhaustive_boruvka(true);
+  int num_trials = 5;
+  while(num_trials--) {
+    generate_stream({1024,0.002,0.5,0,"./sample.txt","./cumul_sample.txt"});
+    std::ifstream in{"./sample.txt"};
+    node_id_t n;
+    edge_id_t m;
+    in >> n >> m;
+    Graph g{n, config};
+    int type;
+    node_id_t a, b;
+    while (m--) {
+      in >> type >> a >> b;
+      g.update({{a, b}, (UpdateType)type});
+    }
+
+    g.set_verifier(std::make_unique<FileGraphVerifier>(1024, "./cumul_sample.txt"));
+    g.connected_components();
+    ASSERT_EQ(g.query_stats.path, BORUVKA);
+    ASSERT_GT(g.query_stats.rounds.size(), 0);
+    ASSERT_LE(g.query_stats.rounds[0].num_reps, n);
+  }
+}
+
 TEST_P(GraphTest, TestPointQuery) {
   auto config = GraphConfiguration().gutter_sys(GetParam());
   const std::string fname = __FILE__;
@@ -254,6 +286,48 @@ TEST_P(GraphTest, TestPointQuery) {
   }
 }
 
+TEST_P(GraphTest, TestPointQueries) {
+  auto config = GraphConfiguration().gutter_sys(GetParam());
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  std::ifstream in{curr_dir + "/res/multiples_graph_1024.txt"};
+  node_id_t num_nodes;
+  in >> num_nodes;
+  edge_id_t m;
+  in >> m;
+  node_id_t a, b;
+  DisjointSetUnion<node_id_t> truth(num_nodes);
+  {
+    Graph g{num_nodes, config};
+    while (m--) {
+      in >> a >> b;
+      g.update({{a, b}, INSERT});
+      truth.merge(a, b);
+    }
+    g.write_binary("./out_temp.txt");
+  }
+
+  std::vector<std::pair<node_id_t, node_id_t>> pairs;
+  for (node_id_t i = 0; i < std::min(100u, num_nodes); ++i) {
+    for (node_id_t j = 0; j < std::min(100u, num_nodes); ++j) {
+      pairs.push_back({i, j});
+    }
+  }
+
+  // a reheated graph has no valid dsu so the first batch runs Boruvka
+  // and the second is answered directly from the dsu
+  Graph reheated{"./out_temp.txt", config};
+  for (int q = 0; q < 2; q++) {
+    reheated.set_verifier(std::make_unique<FileGraphVerifier>(1024, curr_dir + "/res/multiples_graph_1024.txt"));
+    std::vector<bool> answers = reheated.point_queries(pairs);
+    ASSERT_EQ(answers.size(), pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      ASSERT_EQ(answers[i], truth.find_root(pairs[i].first) == truth.find_root(pairs[i].second));
+    }
+  }
+}
+
 TEST(GraphTest, TestQueryDuringStream) {
   auto config = GraphConfiguration()
                 .gutter_sys(STANDALONE)
@@ -374,6 +448,247 @@ TEST(GraphTest, EagerDSUTest) {
   g.connected_components(true);
 }
 
+TEST(GraphTest, EagerDSURecoveryTest) {
+  node_id_t num_nodes = 100;
+  Graph g{num_nodes};
+  MatGraphVerifier verify(num_nodes);
+
+  // build three paths, each of which is a component
+  for (node_id_t start : {0, 20, 40}) {
+    for (node_id_t i = start; i < start + 9; i++) {
+      g.update({{i, i + 1}, INSERT});
+      verify.edge_update(i, i + 1);
+    }
+  }
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  g.connected_components(true);
+
+  // split the first path, join half of it to the second, and then split the second
+  g.update({{4, 5}, DELETE});
+  verify.edge_update(4, 5);
+  g.update({{7, 25}, INSERT});
+  verify.edge_update(7, 25);
+  g.update({{22, 23}, DELETE});
+  verify.edge_update(22, 23);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  auto ret = g.connected_components(true);
+  ASSERT_EQ(ret.size(), num_nodes - 30 + 4);
+
+  ASSERT_FALSE(g.point_query(0, 9));
+  ASSERT_TRUE(g.point_query(5, 29));
+  ASSERT_FALSE(g.point_query(5, 20));
+  ASSERT_TRUE(g.point_query(40, 49));
+
+  // the recovered dsu continues to be maintained eagerly
+  g.update({{4, 20}, INSERT});
+  verify.edge_update(4, 20);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  ASSERT_TRUE(g.point_query(0, 22));
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  g.connected_components(true);
+}
+
+TEST(GraphTest, TestRepeatedQueries) {
+  node_id_t num_nodes = 100;
+  Graph g{num_nodes};
+  MatGraphVerifier verify(num_nodes);
+
+  g.update({{1, 2}, INSERT});
+  verify.edge_update(1, 2);
+  g.update({{2, 3}, INSERT});
+  verify.edge_update(2, 3);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  auto first = g.connected_components(true);
+
+  // no updates in between so this is answered from the cached labels
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  ASSERT_EQ(first, g.connected_components(true));
+  ASSERT_TRUE(g.point_query(1, 3));
+  ASSERT_FALSE(g.point_query(1, 4));
+
+  // delete a spanning forest edge so the next point query must run Boruvka
+  g.update({{2, 3}, DELETE});
+  verify.edge_update(2, 3);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  ASSERT_FALSE(g.point_query(2, 3));
+
+  // the dsu must remain valid after the point query
+  ASSERT_TRUE(g.point_query(1, 2));
+  ASSERT_FALSE(g.point_query(1, 3));
+  auto second = g.connected_components(true);
+  ASSERT_EQ(second.size(), first.size() + 1);
+
+  // an update after the query must be reflected by the next query
+  g.update({{3, 4}, INSERT});
+  verify.edge_update(3, 4);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  ASSERT_TRUE(g.point_query(3, 4));
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  ASSERT_EQ(g.connected_components(true).size(), second.size() - 1);
+}
+
+TEST(GraphTest, TestQueryStats) {
+  node_id_t num_nodes = 100;
+  Graph g{num_nodes};
+  MatGraphVerifier verify(num_nodes);
+  const QueryStats &stats = g.query_stats;
+
+  g.update({{1, 2}, INSERT});
+  verify.edge_update(1, 2);
+  g.update({{2, 3}, INSERT});
+  verify.edge_update(2, 3);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  g.connected_components(true);
+  ASSERT_EQ(stats.path, EAGER_DSU);
+  ASSERT_EQ(stats.rounds.size(), 0);
+
+  // deleting a spanning forest edge requires Boruvka over its component
+  g.update({{2, 3}, DELETE});
+  verify.edge_update(2, 3);
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  g.connected_components(true);
+  ASSERT_EQ(stats.path, BORUVKA);
+  ASSERT_GT(stats.rounds.size(), 0);
+  ASSERT_EQ(stats.rounds[0].num_reps, 3);
+  // only the supernodes that are merged into need to be backed up
+  ASSERT_GT(stats.backup_bytes, 0);
+  ASSERT_EQ(stats.backup_bytes % Supernode::get_size(), 0);
+  for (auto &round : stats.rounds) {
+    ASSERT_EQ(round.num_good + round.num_zero + round.num_fail, round.num_reps);
+    ASSERT_LE(round.sample_time + round.dsu_time + round.backup_time + round.merge_time,
+              round.round_time);
+  }
+
+  // the repeated query is answered from the cache without running Boruvka
+  g.connected_components(true);
+  ASSERT_EQ(stats.path, CACHED);
+  ASSERT_EQ(stats.rounds.size(), 0);
+  ASSERT_EQ(stats.backup_bytes, 0);
+}
+
+TEST(GraphTest, TestHwCounters) {
+  generate_stream({1024, 0.002, 0.5, 0, "./sample.txt", "./cumul_sample.txt"});
+  std::ifstream in{"./sample.txt"};
+  node_id_t n;
+  edge_id_t m;
+  in >> n >> m;
+  Graph g{n, GraphConfiguration().num_groups(2).hw_counters(true)};
+  int type;
+  node_id_t a, b;
+  while (m--) {
+    in >> type >> a >> b;
+    g.update({{a, b}, (UpdateType)type});
+  }
+  g.set_verifier(std::make_unique<FileGraphVerifier>(1024, "./cumul_sample.txt"));
+  g.connected_components(true);
+
+  // every batch is measured once by each of the delta and apply regions
+  HwCounterStats stats = g.hw_counter_stats();
+  ASSERT_TRUE(stats.enabled);
+  ASSERT_EQ(stats.total(DELTA_REGION).calls, g.num_batches);
+  ASSERT_EQ(stats.total(APPLY_REGION).calls, g.num_batches);
+  if (g.query_stats.path == BORUVKA) {
+    ASSERT_GT(stats.total(SAMPLE_REGION).calls, 0);
+  }
+  size_t num_workers = 0;
+  for (auto &thr : stats.threads) {
+    if (thr.name.find("worker") == 0) {
+      ++num_workers;
+    } else {
+      ASSERT_EQ(thr.regions[DELTA_REGION].calls, 0);
+    }
+  }
+  ASSERT_LE(num_workers, 2);
+  // events that could not be opened, for instance without a pmu, read as zero
+  for (int e = 0; e < NUM_HW_EVENTS; e++) {
+    if (!stats.supported[e]) {
+      ASSERT_EQ(stats.total(DELTA_REGION).events[e], 0);
+    }
+  }
+  if (stats.supported[HW_TASK_CLOCK]) {
+    ASSERT_GT(stats.total(DELTA_REGION).events[HW_TASK_CLOCK], 0);
+  }
+
+  g.hw_counters.reset();
+  ASSERT_EQ(g.hw_counter_stats().total(DELTA_REGION).calls, 0);
+}
+
+TEST(GraphTest, TestIngestMetrics) {
+  node_id_t num_nodes = 1024;
+  Graph g{num_nodes, GraphConfiguration().num_groups(2), 2};
+  MatGraphVerifier verify(num_nodes);
+  for (node_id_t i = 1; i < num_nodes; i++) {
+    g.update({{i - 1, i}, INSERT}, i % 2);
+    verify.edge_update(i - 1, i);
+  }
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<decltype(verify)>(verify));
+  g.connected_components();
+
+  // the final query flushes the gutters so every inserted update has been applied
+  IngestMetrics metrics = g.ingest_metrics();
+  ASSERT_EQ(metrics.updates_inserted, 2 * (num_nodes - 1));
+  ASSERT_EQ(metrics.updates_applied, metrics.updates_inserted);
+  ASSERT_EQ(metrics.gutter_backlog(), 0);
+  ASSERT_EQ(metrics.workers.size(), 2);
+  uint64_t batches = 0, updates = 0;
+  for (auto &worker : metrics.workers) {
+    batches += worker.batches;
+    updates += worker.updates;
+    ASSERT_LE(worker.lock_wait_time, worker.apply_time);
+  }
+  ASSERT_EQ(batches, g.num_batches);
+  ASSERT_EQ(updates, metrics.updates_applied);
+
+  std::ostringstream json;
+  metrics.write_json(json);
+  std::string line = json.str();
+  ASSERT_EQ(line.front(), '{');
+  ASSERT_EQ(std::count(line.begin(), line.end(), '\n'), 1);
+  std::ostringstream prometheus;
+  metrics.write_prometheus(prometheus);
+  ASSERT_NE(prometheus.str().find("graphzeppelin_worker_batches_total{worker=\"1\"}"),
+            std::string::npos);
+}
+
+TEST(GraphTest, TestWorkerBatchStats) {
+  // node 0 is a hub adjacent to every other node
+  node_id_t num_nodes = 1024;
+  {
+    Graph g{num_nodes, GraphConfiguration().num_groups(2)};
+    MatGraphVerifier verify(num_nodes);
+    for (node_id_t i = 1; i < num_nodes; i++) {
+      g.update({{0, i}, INSERT});
+      verify.edge_update(0, i);
+    }
+    verify.reset_cc_state();
+    g.set_verifier(std::make_unique<decltype(verify)>(verify));
+    g.connected_components();
+
+    WorkerBatchStats stats = g.worker_batch_stats();
+    ASSERT_EQ(stats.worker_batch_sizes.size(), 2);
+    ASSERT_EQ(stats.batch_sizes.total(), g.num_batches);
+    ASSERT_EQ(stats.worker_batch_sizes[0].total() + stats.worker_batch_sizes[1].total(),
+              g.num_batches);
+    ASSERT_EQ(stats.hot_nodes.total_weight(), 2 * (num_nodes - 1));
+    auto hottest = stats.hot_nodes.top(1);
+    ASSERT_EQ(hottest.size(), 1);
+    ASSERT_EQ(hottest[0].node, 0);
+    ASSERT_GE(hottest[0].count, num_nodes - 1);
+    ASSERT_LE(hottest[0].count - hottest[0].error, num_nodes - 1);
+  }
+  // the statistics are aggregated again when the workers stop
+  ASSERT_EQ(GraphWorker::get_batch_stats().hot_nodes.total_weight(), 2 * (num_nodes - 1));
+}
+
 TEST(GraphTest, MultipleInsertThreads) {
   auto config = GraphConfiguration().gutter_sys(STANDALONE);
   int num_threads = 4;
@@ -420,6 +735,421 @@ TEST(GraphTest, MultipleInsertThreads) {
   g.connected_components();
 }
 
+// The mmap stream must produce exactly the updates of the stream file
+TEST(GraphTest, MMapStreamMatchesBinaryStream) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+
+  // a single reader sees the updates in order
+  {
+    MMapGraphStream stream(stream_file, 256);
+    BinaryGraphStream verify_stream(stream_file, 256);
+    ASSERT_EQ(stream.nodes(), verify_stream.nodes());
+    ASSERT_EQ(stream.edges(), verify_stream.edges());
+
+    MMap_StreamReader reader(stream);
+    for (edge_id_t e = 0; e < verify_stream.edges(); e++) {
+      GraphUpdate upd = reader.get_edge();
+      GraphUpdate expect = verify_stream.get_edge();
+      ASSERT_EQ(upd.type, expect.type);
+      ASSERT_EQ(upd.edge, expect.edge);
+    }
+    ASSERT_EQ(reader.get_edge().type, BREAKPOINT);
+  }
+
+  // many readers split the updates between them and stop at a registered query
+  MMapGraphStream stream(stream_file, 256);
+  edge_id_t query_idx = stream.edges() / 2;
+  ASSERT_TRUE(stream.register_query(query_idx));
+  std::atomic<edge_id_t> num_read;
+  auto task = [&]() {
+    MMap_StreamReader reader(stream);
+    while (reader.get_edge().type != BREAKPOINT) ++num_read;
+  };
+  for (int q = 0; q < 2; q++) {
+    num_read = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) threads.emplace_back(task);
+    for (auto &thr : threads) thr.join();
+    ASSERT_EQ(num_read, q == 0 ? query_idx : stream.edges() - query_idx);
+    stream.post_query_resume();
+  }
+}
+
+TEST(GraphTest, AsyncStreamMatchesBinaryStream) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+
+  // a single reader sees the updates in order, for any queue depth
+  for (size_t depth : {1, 3, 8}) {
+    AsyncGraphStream stream(stream_file, 256, depth, 2);
+    BinaryGraphStream verify_stream(stream_file, 256);
+    ASSERT_EQ(stream.nodes(), verify_stream.nodes());
+    ASSERT_EQ(stream.edges(), verify_stream.edges());
+
+    Async_StreamReader reader(stream);
+    for (edge_id_t e = 0; e < verify_stream.edges(); e++) {
+      GraphUpdate upd = reader.get_edge();
+      GraphUpdate expect = verify_stream.get_edge();
+      ASSERT_EQ(upd.type, expect.type);
+      ASSERT_EQ(upd.edge, expect.edge);
+    }
+    ASSERT_EQ(reader.get_edge().type, BREAKPOINT);
+  }
+
+  // many readers split the updates between them and stop at a registered query
+  // even though they have blocks past the previous ones in flight
+  AsyncGraphStream stream(stream_file, 256, 4, 2);
+  edge_id_t query_idx = stream.edges() / 3;
+  ASSERT_TRUE(stream.register_query(query_idx));
+  std::atomic<edge_id_t> num_read;
+  auto task = [&]() {
+    Async_StreamReader reader(stream);
+    while (reader.get_edge().type != BREAKPOINT) ++num_read;
+  };
+  for (int q = 0; q < 2; q++) {
+    num_read = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) threads.emplace_back(task);
+    for (auto &thr : threads) thr.join();
+    ASSERT_EQ(num_read, q == 0 ? query_idx : stream.edges() - query_idx);
+    stream.post_query_resume();
+  }
+
+  // an on-demand query stops a reader once the blocks it has claimed are drained
+  stream.stream_reset();
+  Async_StreamReader reader(stream);
+  edge_id_t before_query = 0;
+  for (; before_query < 100; before_query++) ASSERT_NE(reader.get_edge().type, BREAKPOINT);
+  stream.on_demand_query();
+  while (reader.get_edge().type != BREAKPOINT) ++before_query;
+  ASSERT_LT(before_query, stream.edges());
+  stream.post_query_resume();
+  edge_id_t after_query = 0;
+  while (reader.get_edge().type != BREAKPOINT) ++after_query;
+  ASSERT_EQ(before_query + after_query, stream.edges());
+}
+
+TEST(GraphTest, CompressedStreamMatchesRawStream) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+  const std::string compressed_file = "./compressed_stream.data";
+
+  // blocks survive extreme deltas between node ids
+  char raw[4 * 9];
+  node_id_t ids[8] = {0, 4294967294, 4294967294, 0, 7, 7, 123456, 1};
+  for (int i = 0; i < 4; i++) {
+    raw[i * 9] = i % 2;
+    std::memcpy(raw + i * 9 + 1, &ids[2 * i], sizeof(node_id_t));
+    std::memcpy(raw + i * 9 + 5, &ids[2 * i + 1], sizeof(node_id_t));
+  }
+  std::vector<char> payload(max_compressed_size(4));
+  char decoded[4 * 9];
+  size_t payload_size = compress_block(raw, 4, payload.data());
+  ASSERT_TRUE(decompress_block(payload.data(), payload_size, 4, decoded));
+  ASSERT_EQ(std::memcmp(raw, decoded, sizeof(raw)), 0);
+  ASSERT_FALSE(decompress_block(payload.data(), payload_size - 1, 4, decoded));
+
+  // write a compressed copy of the stream whose blocks do not align with the query below
+  std::vector<GraphUpdate> raw_upds;
+  {
+    BinaryGraphStream raw_stream(stream_file, 1024);
+    std::ofstream out(compressed_file, std::ios_base::binary | std::ios_base::out);
+    CompressedStreamWriter writer(out, raw_stream.nodes(), raw_stream.edges(), 100);
+    for (edge_id_t e = 0; e < raw_stream.edges(); e++) {
+      GraphUpdate upd = raw_stream.get_edge();
+      writer.write(upd.type, upd.edge.src, upd.edge.dst);
+      raw_upds.push_back(upd);
+    }
+    writer.finish();
+    ASSERT_LT(writer.blocks_size(), raw_stream.edges() * 9);
+  }
+
+  // a single threaded stream decodes the same updates
+  BinaryGraphStream stream(compressed_file, 1024);
+  ASSERT_EQ(stream.edges(), raw_upds.size());
+  for (GraphUpdate expect : raw_upds) {
+    GraphUpdate upd = stream.get_edge();
+    ASSERT_EQ(upd.type, expect.type);
+    ASSERT_EQ(upd.edge, expect.edge);
+  }
+
+  // many readers decode the same updates and stop at a query in the middle of a block
+  BinaryGraphStream_MT mt_stream(compressed_file, 1024);
+  ASSERT_EQ(mt_stream.nodes(), stream.nodes());
+  edge_id_t query_idx = 250;
+  ASSERT_TRUE(mt_stream.register_query(query_idx));
+  std::mutex upds_lock;
+  std::vector<GraphUpdate> mt_upds;
+  auto task = [&]() {
+    MT_StreamReader reader(mt_stream);
+    GraphUpdate upd;
+    while ((upd = reader.get_edge()).type != BREAKPOINT) {
+      std::lock_guard<std::mutex> lk(upds_lock);
+      mt_upds.push_back(upd);
+    }
+  };
+  auto by_edge = [](const GraphUpdate &a, const GraphUpdate &b) {
+    return a.edge < b.edge || (a.edge == b.edge && a.type < b.type);
+  };
+  for (int q = 0; q < 2; q++) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; t++) threads.emplace_back(task);
+    for (auto &thr : threads) thr.join();
+    ASSERT_EQ(mt_upds.size(), q == 0 ? query_idx : raw_upds.size());
+    mt_stream.post_query_resume();
+  }
+  std::sort(mt_upds.begin(), mt_upds.end(), by_edge);
+  std::sort(raw_upds.begin(), raw_upds.end(), by_edge);
+  for (size_t i = 0; i < raw_upds.size(); i++) {
+    ASSERT_EQ(mt_upds[i].type, raw_upds[i].type);
+    ASSERT_EQ(mt_upds[i].edge, raw_upds[i].edge);
+  }
+
+  // after a query splits a block, the next claim takes the rest of it and later claims are
+  // aligned to blocks so that no block is decoded twice
+  struct ClaimingStream : public BinaryGraphStream_MT {
+    using BinaryGraphStream_MT::BinaryGraphStream_MT;
+    using BinaryGraphStream_MT::claim_block;
+  } claim_stream(compressed_file, 1024);
+  const uint64_t header_size = max_stream_header_size, block_size = 100 * raw_update_size;
+  ASSERT_TRUE(claim_stream.register_query(query_idx));
+  uint64_t read_off;
+  std::vector<std::pair<uint64_t, uint32_t>> claims;
+  for (int q = 0; q < 2; q++) {
+    uint32_t size;
+    while ((size = claim_stream.claim_block(read_off)) > 0) claims.emplace_back(read_off, size);
+    claim_stream.post_query_resume();
+  }
+  uint64_t expect_off = header_size;
+  for (auto &claim : claims) {
+    ASSERT_EQ(claim.first, expect_off);
+    ASSERT_EQ((claim.first - header_size) / block_size,
+              (claim.first + claim.second - 1 - header_size) / block_size);
+    expect_off += claim.second;
+  }
+  ASSERT_EQ(expect_off, header_size + raw_upds.size() * raw_update_size);
+  ASSERT_EQ(claims.size(), (raw_upds.size() + 99) / 100 + 1);
+
+  // a block too large for the readers' buffers is rejected
+  char header_data[max_stream_header_size];
+  {
+    std::ifstream in(compressed_file, std::ios_base::binary);
+    in.read(header_data, max_stream_header_size);
+  }
+  StreamHeader header;
+  ASSERT_TRUE(parse_stream_header(header_data, max_stream_header_size, header));
+  uint32_t too_large = max_block_upds + 1;
+  std::memcpy(header_data + versioned_header_size, &too_large, sizeof(too_large));
+  ASSERT_FALSE(parse_stream_header(header_data, max_stream_header_size, header));
+  std::ostringstream sink;
+  ASSERT_THROW(CompressedStreamWriter(sink, 1024, 1, too_large), std::invalid_argument);
+
+  // streams that read the file directly cannot read the compressed format
+  ASSERT_THROW(MMapGraphStream(compressed_file, 1024), StreamFormatException);
+}
+
+// compressed streams read by AsyncGraphStream, as process_stream does, give the same graph
+TEST(GraphTest, CompressedStreamThroughAsyncStream) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+  const std::string compressed_file = "./compressed_stream.data";
+
+  std::vector<GraphUpdate> raw_upds;
+  MatGraphVerifier verify(1024);
+  {
+    BinaryGraphStream raw_stream(stream_file, 1024);
+    std::ofstream out(compressed_file, std::ios_base::binary | std::ios_base::out);
+    CompressedStreamWriter writer(out, raw_stream.nodes(), raw_stream.edges(), 100);
+    for (edge_id_t e = 0; e < raw_stream.edges(); e++) {
+      GraphUpdate upd = raw_stream.get_edge();
+      writer.write(upd.type, upd.edge.src, upd.edge.dst);
+      raw_upds.push_back(upd);
+      verify.edge_update(upd.edge.src, upd.edge.dst);
+    }
+    writer.finish();
+  }
+
+  // a single reader sees the updates in order, including across a query within a block
+  AsyncGraphStream stream(compressed_file, 1024, 3, 2);
+  ASSERT_EQ(stream.format(), COMPRESSED_FORMAT);
+  ASSERT_EQ(stream.edges(), raw_upds.size());
+  edge_id_t query_idx = 250;
+  ASSERT_TRUE(stream.register_query(query_idx));
+  {
+    Async_StreamReader reader(stream);
+    for (edge_id_t e = 0; e < raw_upds.size(); e++) {
+      GraphUpdate upd = reader.get_edge();
+      if (e == query_idx) {
+        ASSERT_EQ(upd.type, BREAKPOINT);
+        stream.post_query_resume();
+        upd = reader.get_edge();
+      }
+      ASSERT_EQ(upd.type, raw_upds[e].type);
+      ASSERT_EQ(upd.edge, raw_upds[e].edge);
+    }
+    ASSERT_EQ(reader.get_edge().type, BREAKPOINT);
+  }
+
+  // ingest the stream with the reader threads of process_stream
+  AsyncGraphStream ingest_stream(compressed_file, 1024 * 32);
+  auto config = GraphConfiguration().gutter_sys(STANDALONE);
+  Graph g(ingest_stream.nodes(), config, 2);
+  auto task = [&](const int thr_id) {
+    Async_StreamReader reader(ingest_stream);
+    std::vector<GraphUpdate> upds(1024);
+    size_t num_upds;
+    while ((num_upds = reader.get_edges(upds.data(), upds.size())) > 0)
+      g.update_batch(upds.data(), num_upds, thr_id);
+  };
+  std::thread t0(task, 0);
+  std::thread t1(task, 1);
+  t0.join();
+  t1.join();
+
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<MatGraphVerifier>(verify));
+  ASSERT_EQ(g.connected_components().size(), 78);
+}
+
+TEST(GraphTest, CompactStreamMatchesRawStream) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+  const std::string compact_file = "./compact_stream.data";
+
+  std::vector<GraphUpdate> raw_upds;
+  {
+    BinaryGraphStream raw_stream(stream_file, 1024);
+    ASSERT_EQ(raw_stream.format(), RAW_FORMAT);
+    std::ofstream out(compact_file, std::ios_base::binary | std::ios_base::out);
+    StreamHeader header;
+    header.format    = COMPACT_FORMAT;
+    header.num_nodes = raw_stream.nodes();
+    header.num_upds  = raw_stream.edges();
+    write_stream_header(out, header);
+    for (edge_id_t e = 0; e < raw_stream.edges(); e++) {
+      GraphUpdate upd = raw_stream.get_edge();
+      write_compact_update(out, upd.type, upd.edge.src, upd.edge.dst);
+      raw_upds.push_back(upd);
+    }
+  }
+
+  auto expect_updates = [&](std::function<GraphUpdate()> get_edge) {
+    for (GraphUpdate expect : raw_upds) {
+      GraphUpdate upd = get_edge();
+      ASSERT_EQ(upd.type, expect.type);
+      ASSERT_EQ(upd.edge, expect.edge);
+    }
+  };
+  // the header is padded so that every update is aligned within the file
+  char header_data[max_stream_header_size];
+  {
+    std::ifstream in(compact_file, std::ios_base::binary);
+    in.read(header_data, max_stream_header_size);
+  }
+  StreamHeader header;
+  ASSERT_TRUE(parse_stream_header(header_data, max_stream_header_size, header));
+  ASSERT_EQ(header.size, compact_header_size);
+  ASSERT_EQ(header.size % compact_update_size, 0);
+  ASSERT_FALSE(parse_stream_header(header_data, versioned_header_size, header));
+
+  BinaryGraphStream stream(compact_file, 1024);
+  ASSERT_EQ(stream.format(), COMPACT_FORMAT);
+  ASSERT_EQ(stream.nodes(), 1024);
+  ASSERT_EQ(stream.edges(), raw_upds.size());
+  expect_updates([&]() { return stream.get_edge(); });
+
+  BinaryGraphStream_MT mt_stream(compact_file, 1024);
+  MT_StreamReader mt_reader(mt_stream);
+  expect_updates([&]() { return mt_reader.get_edge(); });
+  ASSERT_EQ(mt_reader.get_edge().type, BREAKPOINT);
+
+  MMapGraphStream mmap_stream(compact_file, 1024);
+  MMap_StreamReader mmap_reader(mmap_stream);
+  expect_updates([&]() { return mmap_reader.get_edge(); });
+
+  AsyncGraphStream async_stream(compact_file, 1024);
+  Async_StreamReader async_reader(async_stream);
+  expect_updates([&]() { return async_reader.get_edge(); });
+
+  // batches and registered queries are in units of 8 byte updates
+  BinaryGraphStream_MT query_stream(compact_file, 1024);
+  ASSERT_TRUE(query_stream.register_query(1000));
+  MT_StreamReader query_reader(query_stream);
+  GraphUpdate upds[64];
+  size_t num, total = 0;
+  while ((num = query_reader.get_edges(upds, 64)) > 0) {
+    for (size_t i = 0; i < num; i++) ASSERT_EQ(upds[i].edge, raw_upds[total + i].edge);
+    total += num;
+  }
+  ASSERT_EQ(total, 1000);
+
+  // versions this build does not know are rejected
+  {
+    std::ofstream out(compact_file, std::ios_base::binary | std::ios_base::out);
+    uint32_t unknown[6] = {stream_format_marker, 99, 1024, 0, 0, 0};
+    out.write((const char *) unknown, sizeof(unknown));
+  }
+  ASSERT_THROW(BinaryGraphStream(compact_file, 1024), StreamFormatException);
+  ASSERT_THROW(BinaryGraphStream_MT(compact_file, 1024), StreamFormatException);
+}
+
+TEST(GraphTest, BatchStreamUpdates) {
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string stream_file = curr_dir + "/res/multiples_graph_1024_stream.data";
+
+  // batches that cross the buffer boundary decode the same updates as get_edge
+  BinaryGraphStream batch_stream(stream_file, 256);
+  BinaryGraphStream verify_stream(stream_file, 256);
+  node_id_t num_nodes = verify_stream.nodes();
+  edge_id_t num_edges = verify_stream.edges();
+  MatGraphVerifier verify(num_nodes);
+  GraphUpdate upds[17];
+  size_t num_upds;
+  edge_id_t total = 0;
+  while ((num_upds = batch_stream.get_edges(upds, 17)) > 0) {
+    for (size_t i = 0; i < num_upds; i++) {
+      GraphUpdate expect = verify_stream.get_edge();
+      ASSERT_EQ(upds[i].type, expect.type);
+      ASSERT_EQ(upds[i].edge, expect.edge);
+      verify.edge_update(expect.edge.src, expect.edge.dst);
+    }
+    total += num_upds;
+  }
+  ASSERT_EQ(total, num_edges);
+
+  // many threads inserting batches produce the same connected components
+  auto config = GraphConfiguration().gutter_sys(STANDALONE);
+  BinaryGraphStream_MT stream(stream_file, 256);
+  Graph g(num_nodes, config, 2);
+  auto task = [&](const int thr_id) {
+    MT_StreamReader reader(stream);
+    GraphUpdate batch[10];
+    size_t num;
+    while ((num = reader.get_edges(batch, 10)) > 0) g.update_batch(batch, num, thr_id);
+  };
+  std::thread t0(task, 0);
+  std::thread t1(task, 1);
+  t0.join();
+  t1.join();
+
+  verify.reset_cc_state();
+  g.set_verifier(std::make_unique<MatGraphVerifier>(verify));
+  ASSERT_EQ(g.connected_components().size(), 78);
+}
+
 TEST(GraphTest, MTStreamWithMultipleQueries) {
   for(int i = 1; i <= 3; i++) {
     auto config = GraphConfiguration().gutter_sys(STANDALONE);
@@ -533,3 +1263,45 @@ TEST(GraphTest, MTStreamWithMultipleQueries) {
     ASSERT_EQ(g.connected_components().size(), 78);
   }
 }
+
+// A dense graph collapses into one giant component in the first round so merging
+// splits its merge list across threads. Force multiple threads so this is exercised.
+TEST(GraphTest, TestSkewedMerge) {
+  // restore the number of threads even if an assertion fails
+  struct OmpThreadsGuard {
+    int num_threads = omp_get_max_threads();
+    ~OmpThreadsGuard() { omp_set_num_threads(num_threads); }
+  } guard;
+  omp_set_num_threads(8);
+  generate_stream({1024, 0.2, 0.5, 0, "./sample.txt", "./cumul_sample.txt"});
+  std::ifstream in{"./sample.txt"};
+  node_id_t n;
+  edge_id_t m;
+  in >> n >> m;
+  Graph g{n};
+  int type;
+  node_id_t a, b;
+  Edge first_edge;
+  for (edge_id_t i = 0; i < m; i++) {
+    in >> type >> a >> b;
+    if (i == 0) first_edge = {a, b};
+    g.update({{a, b}, (UpdateType)type});
+  }
+  // the first edge of the stream joins two singletons so it is in the spanning forest of the
+  // eager dsu. Deleting and reinserting it leaves the graph unchanged but invalidates the
+  // dsu of the giant component so that the query must run Boruvka.
+  g.update({first_edge, DELETE});
+  g.update({first_edge, INSERT});
+
+  // first query restores the supernodes so the second must produce the same answer
+  g.set_verifier(std::make_unique<FileGraphVerifier>(1024, "./cumul_sample.txt"));
+  auto first = g.connected_components(true);
+  ASSERT_EQ(g.query_stats.path, BORUVKA);
+  size_t num_split = 0;
+  for (auto &round : g.query_stats.rounds) num_split += round.num_split;
+  ASSERT_GT(num_split, 0u);
+  g.update({{0, 1}, INSERT});
+  g.update({{0, 1}, DELETE});
+  g.set_verifier(std::make_unique<FileGraphVerifier>(1024, "./cumul_sample.txt"));
+  ASSERT_EQ(first, g.connected_components());
+}
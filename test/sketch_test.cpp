@@ -1,5 +1,6 @@
 #include "../include/l0_sampling/sketch.h"
 #include <chrono>
+#include <random>
 #include <gtest/gtest.h>
 #include "../include/test/testing_vector.h"
 #include "../include/test/sketch_constructors.h"
@@ -375,3 +376,33 @@ TEST(SketchTestSuite, TestExhaustiveQuery) {
     ASSERT_EQ(unique_elms.size(), query_ret.first.size());
   }
 }
+
+TEST(SketchTestSuite, TestVectorizedQueryKernel) {
+  std::mt19937_64 gen(rand());
+  for (size_t num : {0, 1, 3, 4, 5, 17, 64, 161}) {
+    for (size_t trial = 0; trial < 100; trial++) {
+      uint64_t seed = gen();
+      std::vector<vec_t> a(num, 0);
+      std::vector<vec_hash_t> c(num, 0);
+      for (size_t i = 0; i < num; i++) {
+        // leave some buckets empty, make a few good, and fill the rest with noise
+        switch (gen() % 4) {
+          case 0: break;
+          case 1: a[i] = gen(); c[i] = Bucket_Boruvka::get_index_hash(a[i], seed); break;
+          default: a[i] = gen(); c[i] = gen(); break;
+        }
+      }
+      size_t expected = num;
+      for (size_t i = 0; i < num && expected == num; i++)
+        if (Bucket_Boruvka::is_good(a[i], c[i], seed)) expected = i;
+
+      ASSERT_EQ(expected, Sketch::first_good_bucket_scalar(a.data(), c.data(), num, seed));
+      ASSERT_EQ(expected, Sketch::first_good_bucket(a.data(), c.data(), num, seed));
+#if defined(__x86_64__) && defined(__GNUC__)
+      if (__builtin_cpu_supports("avx2")) {
+        ASSERT_EQ(expected, Sketch::first_good_bucket_avx2(a.data(), c.data(), num, seed));
+      }
+#endif
+    }
+  }
+}
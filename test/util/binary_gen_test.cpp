@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <unordered_set>
+#include "../../include/test/efficient_gen.h"
+#include "../../include/test/file_graph_verifier.h"
+#include "../../include/binary_graph_stream.h"
+#include "../../include/graph.h"
+
+static inline uint64_t edge_key(Edge e) {
+  return (uint64_t) std::min(e.src, e.dst) << 32 | std::max(e.src, e.dst);
+}
+
+TEST(BinaryGenTestSuite, TestStreamMatchesCumul) {
+  node_id_t n = 300;
+  double p = 0.1;
+  uint64_t num_upds = write_binary_stream(n, p, 0.5, "./binary_gen.data", "./binary_gen_cumul.data", 3, 42);
+
+  // the stream inserts m distinct edges and then deletes and reinserts some of them
+  uint64_t m = (uint64_t) (n * (n - 1) / 2 * p);
+  BinaryGraphStream stream("./binary_gen.data", 1024 * 32);
+  ASSERT_EQ(stream.nodes(), n);
+  ASSERT_EQ(stream.edges(), num_upds);
+  ASSERT_GT(num_upds, m);
+  std::unordered_set<uint64_t> present;
+  for (uint64_t i = 0; i < num_upds; i++) {
+    GraphUpdate upd = stream.get_edge();
+    ASSERT_LT(upd.edge.src, upd.edge.dst);
+    ASSERT_LT(upd.edge.dst, n);
+    ASSERT_EQ(upd.type, i < m ? INSERT : upd.type);
+    if (upd.type == INSERT)
+      ASSERT_TRUE(present.insert(edge_key(upd.edge)).second) << "double insert at update " << i;
+    else
+      ASSERT_EQ(present.erase(edge_key(upd.edge)), 1u) << "delete before insert at update " << i;
+  }
+
+  // the cumulative graph is exactly the edges present at the end of the stream
+  BinaryGraphStream cumul("./binary_gen_cumul.data", 1024 * 32);
+  ASSERT_EQ(cumul.format(), COMPACT_FORMAT);
+  ASSERT_EQ(cumul.edges(), present.size());
+  for (uint64_t i = 0; i < cumul.edges(); i++) {
+    GraphUpdate upd = cumul.get_edge();
+    ASSERT_EQ(upd.type, INSERT);
+    ASSERT_EQ(present.erase(edge_key(upd.edge)), 1u);
+  }
+}
+
+TEST(BinaryGenTestSuite, TestIndependentOfThreads) {
+  write_binary_stream(500, 0.05, 0.3, "./binary_gen.data", "", 1, 7);
+  write_binary_stream(500, 0.05, 0.3, "./binary_gen_cumul.data", "", 4, 7);
+  BinaryGraphStream a("./binary_gen.data", 1024 * 32);
+  BinaryGraphStream b("./binary_gen_cumul.data", 1024 * 32);
+  ASSERT_EQ(a.edges(), b.edges());
+  for (uint64_t i = 0; i < a.edges(); i++) {
+    GraphUpdate x = a.get_edge(), y = b.get_edge();
+    ASSERT_EQ(x.edge, y.edge);
+    ASSERT_EQ(x.type, y.type);
+  }
+}
+
+TEST(BinaryGenTestSuite, TestVerifyWithBinaryCumul) {
+  node_id_t n = 1024;
+  uint64_t num_upds = write_binary_stream(n, 0.002, 0.5, "./binary_gen.data", "./binary_gen_cumul.data", 2, 3);
+  BinaryGraphStream stream("./binary_gen.data", 1024 * 32);
+  Graph g{n};
+  for (uint64_t i = 0; i < num_upds; i++) g.update(stream.get_edge());
+
+  g.set_verifier(std::make_unique<FileGraphVerifier>(n, "./binary_gen_cumul.data"));
+  g.connected_components();
+  std::remove("./binary_gen.data");
+  std::remove("./binary_gen_cumul.data");
+}
+
+TEST(BinaryGenTestSuite, TestVerifierRejectsRawCumul) {
+  // a raw binary cumul, as written when n does not fit in 31 bits, has no format marker
+  const std::string fname = __FILE__;
+  size_t pos = fname.find_last_of("\\/");
+  const std::string curr_dir = (std::string::npos == pos) ? "" : fname.substr(0, pos);
+  const std::string raw_file = curr_dir + "/../res/multiples_graph_1024_stream.data";
+  ASSERT_THROW(FileGraphVerifier(1024, raw_file), std::invalid_argument);
+}
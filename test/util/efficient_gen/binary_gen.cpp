@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../../include/test/efficient_gen.h"
+#include "../../../include/test/stream_gen.h"
+#include "../../../include/binary_stream_format.h"
+#include "../../../include/types.h"
+
+namespace {
+
+// the idx'th pair (i, j) with i < j in lexicographic order
+Edge unrank_pair(uint64_t idx, uint64_t n) {
+  // row i holds the pairs [start(i), start(i+1))
+  auto start = [n](uint64_t i) { return (unsigned __int128) i * n - (unsigned __int128) i * (i + 1) / 2; };
+  long double half = n - 0.5L;
+  uint64_t i = (uint64_t) std::max(0.0L, half - std::sqrt(std::max(0.0L, half * half - 2.0L * idx)));
+  while (i > 0 && start(i) > idx) i--;
+  while (start(i + 1) <= idx) i++;
+  return {(node_id_t) i, (node_id_t) (idx - start(i) + i + 1)};
+}
+
+// a run of updates upon the edges [first, first + num) of the permuted order
+struct Segment {
+  uint64_t first;
+  uint64_t num;
+  uint8_t type;
+};
+
+void write_all(int fd, const char *buf, size_t len, uint64_t off) {
+  while (len > 0) {
+    ssize_t ret = pwrite(fd, buf, len, off);
+    if (ret < 0) throw std::runtime_error("could not write stream: " + std::string(strerror(errno)));
+    buf += ret;
+    off += ret;
+    len -= ret;
+  }
+}
+
+/*
+ * Write a binary stream made of the segments one after another. Each thread encodes and
+ * writes an equal contiguous range of the updates at its precomputed offset in the file.
+ */
+void write_segments(const std::string &file, StreamHeader header, const std::vector<Segment> &segments,
+                    const IndexPermutation &perm, uint64_t n, int num_threads) {
+  std::vector<uint64_t> seg_offs(segments.size() + 1, 0);
+  for (size_t s = 0; s < segments.size(); s++) seg_offs[s + 1] = seg_offs[s] + segments[s].num;
+  header.num_upds = seg_offs.back();
+
+  int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) throw std::runtime_error("could not open " + file + ": " + strerror(errno));
+  std::ostringstream header_out;
+  write_stream_header(header_out, header);
+  std::string header_data = header_out.str();
+  write_all(fd, header_data.data(), header_data.size(), 0);
+
+  size_t upd_size = header.update_size();
+  bool compact = header.format == COMPACT_FORMAT;
+  auto task = [&](int thr_id) {
+    uint64_t begin = header.num_upds * thr_id / num_threads;
+    uint64_t end   = header.num_upds * (thr_id + 1) / num_threads;
+    size_t seg = std::upper_bound(seg_offs.begin(), seg_offs.end(), begin) - seg_offs.begin() - 1;
+    std::vector<char> buf((1 << 20) / upd_size * upd_size);
+    size_t batch = buf.size() / upd_size;
+    for (uint64_t pos = begin; pos < end; pos += batch) {
+      size_t num = std::min((uint64_t) batch, end - pos);
+      for (size_t i = 0; i < num; i++) {
+        while (pos + i >= seg_offs[seg + 1]) ++seg;
+        const Segment &s = segments[seg];
+        Edge e = unrank_pair(perm(s.first + pos + i - seg_offs[seg]), n);
+        if (compact) encode_compact_update(buf.data() + i * upd_size, s.type, e.src, e.dst);
+        else         encode_raw_update(buf.data() + i * upd_size, s.type, e.src, e.dst);
+      }
+      write_all(fd, buf.data(), num * upd_size, header_data.size() + pos * upd_size);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) threads.emplace_back(task, t);
+  for (auto &thr : threads) thr.join();
+  close(fd);
+}
+
+} // namespace
+
+uint64_t write_binary_stream(uint32_t n, double p, double r, const std::string& out_file,
+                             const std::string& cumul_file, int num_threads, uint64_t seed) {
+  num_threads = std::max(num_threads, 1);
+  uint64_t num_pairs = (uint64_t) n * (n - 1) / 2;
+  uint64_t m = (uint64_t) (num_pairs * p);
+  if (n < 2 || m == 0 || m > num_pairs)
+    throw std::invalid_argument("p must give between 1 and n(n-1)/2 edges");
+
+  // the same geometric insertion/deletion schedule as insert_delete: phase k updates the
+  // first phase_upds[k] edges of the permuted order, inserting if k is even
+  std::vector<uint64_t> phase_upds = {m};
+  while (phase_upds.back() > 1 && (uint64_t) (phase_upds.back() * r) > 0)
+    phase_upds.push_back((uint64_t) (phase_upds.back() * r));
+
+  std::vector<Segment> stream_segs;
+  for (size_t k = 0; k < phase_upds.size(); k++)
+    stream_segs.push_back({0, phase_upds[k], (uint8_t) (k % 2 == 0 ? INSERT : DELETE)});
+
+  IndexPermutation perm(num_pairs, seed);
+  StreamHeader header;
+  header.num_nodes = n;
+  write_segments(out_file, header, stream_segs, perm, n, num_threads);
+
+  if (!cumul_file.empty()) {
+    // edges [phase_upds[k+1], phase_upds[k]) appear k+1 times so are present if k is even
+    std::vector<Segment> cumul_segs;
+    for (size_t k = 0; k < phase_upds.size(); k += 2) {
+      uint64_t first = k + 1 < phase_upds.size() ? phase_upds[k + 1] : 0;
+      cumul_segs.push_back({first, phase_upds[k] - first, INSERT});
+    }
+    StreamHeader cumul_header;
+    cumul_header.format = n <= compact_type_bit ? COMPACT_FORMAT : RAW_FORMAT;
+    cumul_header.num_nodes = n;
+    write_segments(cumul_file, cumul_header, cumul_segs, perm, n, num_threads);
+  }
+
+  uint64_t num_upds = 0;
+  for (uint64_t upds : phase_upds) num_upds += upds;
+  return num_upds;
+}
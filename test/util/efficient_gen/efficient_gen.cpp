@@ -1,7 +1,49 @@
 #include <iostream>
+#include <random>
+#include <string>
+#include <thread>
 #include "../../../include/test/efficient_gen.h"
 
-int main() {
+// efficient_gen --binary n p r out_file [cumul_file] [--threads num] [--seed s]
+static int binary_main(int argc, char **argv) {
+  if (argc < 6) {
+    std::cout << "Arguments are: --binary n p r out_file [cumul_file] [--threads num] [--seed s]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  uint32_t n = std::stoul(argv[2]);
+  double p = std::stod(argv[3]);
+  double r = std::stod(argv[4]);
+  std::string out_file = argv[5];
+  std::string cumul_file;
+  int num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  uint64_t seed = std::random_device()();
+  for (int i = 6; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc)   num_threads = std::stoi(argv[++i]);
+    else if (arg == "--seed" && i + 1 < argc) seed = std::stoull(argv[++i]);
+    else if (cumul_file.empty() && arg[0] != '-') cumul_file = arg;
+    else {
+      std::cerr << "Did not recognize argument: " << arg << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto start = time(nullptr);
+  uint64_t num_upds;
+  try {
+    num_upds = write_binary_stream(n, p, r, out_file, cumul_file, num_threads, seed);
+  } catch (std::exception &e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Wrote " << num_upds << " updates" << std::endl;
+  std::cout << "Completed in " << time(nullptr)-start << " seconds" << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "--binary") return binary_main(argc, argv);
+
   int n; double p, r = 0.1; std::string s,t; char c = 0; bool cumul = false;
   std::cout << "n: "; std::cin >> n;
   std::cout << "p: "; std::cin >> p;
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../../include/test/stream_gen.h"
+#include "../../../include/binary_stream_format.h"
+#include "../../../include/types.h"
+
+namespace {
+
+// the number of random draws an edge sample may consume
+constexpr uint64_t draw_stride = 64;
+// the minimum number of node ranges the adjacency matrix is divided by. Gives enough cells
+// to keep the generating threads busy.
+constexpr uint32_t min_ranges = 16;
+// each phase of the stream is divided into slots of this many updates which are shuffled
+// so that the cells, and so the node ranges, are interleaved throughout the phase
+constexpr uint64_t slot_upds  = 1024;
+// bound on the number of cell groups whose offsets within each phase are tabulated
+constexpr size_t max_groups   = 4096;
+
+struct Cell {
+  uint32_t row;
+  uint32_t col;     // row <= col. The cell holds edges (src, dst) with src in row, dst in col
+  uint64_t capacity;
+  edge_id_t num_edges;
+};
+
+// Memory budget of the state kept for every cell: the cell itself and, while apportioning
+// edges or counting the updates of each phase, five more words. Bounds the number of cells.
+constexpr size_t cell_memory_budget = 1 << 26;
+constexpr size_t max_cells = cell_memory_budget / (sizeof(Cell) + 5 * sizeof(uint64_t));
+
+inline uint64_t edge_key(node_id_t a, node_id_t b) {
+  if (a > b) std::swap(a, b);
+  return (uint64_t) a << 32 | b;
+}
+
+/*
+ * Divides the upper triangle of the adjacency matrix into cells by node range and samples
+ * the edges of each cell according to the model.
+ */
+class CellModel {
+public:
+  CellModel(const StreamGenSettings &s, uint32_t num_ranges) : s(s), num_ranges(num_ranges) {
+    if (s.model == RMAT) {
+      rmat_d = 1 - s.rmat_a - s.rmat_b - s.rmat_c;
+      scale  = __builtin_ctz(s.num_nodes);
+      levels = __builtin_ctz(num_ranges);
+    }
+    if (s.model == POWER_LAW) beta = 1 / (s.power_law_exponent - 1);
+  }
+
+  inline node_id_t range_lo(uint32_t r) const {
+    return (uint64_t) s.num_nodes * r / num_ranges;
+  }
+  inline node_id_t range_size(uint32_t r) const { return range_lo(r + 1) - range_lo(r); }
+
+  // the number of distinct edges within the cell
+  uint64_t capacity(uint32_t row, uint32_t col) const {
+    uint64_t rows = range_size(row);
+    return row == col ? rows * (rows - 1) / 2 : rows * range_size(col);
+  }
+
+  // the (unnormalized) probability that an edge of the model falls within the cell
+  double weight(uint32_t row, uint32_t col) const {
+    switch (s.model) {
+      case RMAT:
+        return row == col ? rmat_prob(row, col) : rmat_prob(row, col) + rmat_prob(col, row);
+      case POWER_LAW:
+        return (row == col ? 1 : 2) * power_law_weight(row) * power_law_weight(col);
+      default:
+        return capacity(row, col);
+    }
+  }
+
+  /*
+   * Sample an edge of the cell. The result may be a self loop or an edge that was already
+   * sampled, which the caller rejects.
+   * @param rng   the random number generator of the cell
+   * @param draw  the index of this sample. Uses counters [draw * draw_stride, (draw+1) * draw_stride)
+   */
+  Edge sample(uint32_t row, uint32_t col, const CounterRng &rng, uint64_t draw) const {
+    uint64_t ctr = draw * draw_stride;
+    node_id_t row_lo = range_lo(row);
+    node_id_t col_lo = range_lo(col);
+    switch (s.model) {
+      case RMAT: {
+        // an off diagonal cell folds together (row, col) and (col, row) of the directed matrix
+        bool transposed = row != col &&
+            rng.uniform(ctr++) * (rmat_prob(row, col) + rmat_prob(col, row)) >= rmat_prob(row, col);
+        double b = transposed ? s.rmat_c : s.rmat_b;
+        double c = transposed ? s.rmat_b : s.rmat_c;
+        node_id_t src = 0, dst = 0;
+        for (uint32_t l = levels; l < scale; l++) {
+          double u = rng.uniform(ctr++);
+          src <<= 1;
+          dst <<= 1;
+          if (u < s.rmat_a) continue;
+          if (u < s.rmat_a + b) dst |= 1;
+          else if (u < s.rmat_a + b + c) src |= 1;
+          else { src |= 1; dst |= 1; }
+        }
+        return {row_lo + src, col_lo + dst};
+      }
+      case POWER_LAW:
+        return {power_law_node(row, rng.uniform(ctr)), power_law_node(col, rng.uniform(ctr + 1))};
+      default:
+        return {row_lo + (node_id_t) rng.bounded(ctr, range_size(row)),
+                col_lo + (node_id_t) rng.bounded(ctr + 1, range_size(col))};
+    }
+  }
+
+private:
+  const StreamGenSettings &s;
+  uint32_t num_ranges;
+  double rmat_d = 0;
+  uint32_t scale = 0;   // log2 of the number of nodes
+  uint32_t levels = 0;  // log2 of the number of ranges
+  double beta = 0;      // node i has weight (i+1)^-beta
+
+  // probability of the cell of the directed R-MAT matrix
+  double rmat_prob(uint32_t row, uint32_t col) const {
+    double p = 1;
+    for (uint32_t l = 0; l < levels; l++) {
+      bool r = (row >> l) & 1, c = (col >> l) & 1;
+      p *= r ? (c ? rmat_d : s.rmat_c) : (c ? s.rmat_b : s.rmat_a);
+    }
+    return p;
+  }
+
+  // the weights are approximated by the continuous density x^-beta where node i is [i+1, i+2)
+  inline double power_law_cdf(double x) const { return std::pow(x, 1 - beta); }
+
+  double power_law_weight(uint32_t r) const {
+    return power_law_cdf(range_lo(r + 1) + 1.0) - power_law_cdf(range_lo(r) + 1.0);
+  }
+
+  // invert the cumulative weight to sample a node of the range
+  node_id_t power_law_node(uint32_t r, double u) const {
+    double lo = power_law_cdf(range_lo(r) + 1.0);
+    double hi = power_law_cdf(range_lo(r + 1) + 1.0);
+    double x = std::pow(lo + u * (hi - lo), 1 / (1 - beta));
+    int64_t node = (int64_t) x - 1;
+    return std::min(std::max(node, (int64_t) range_lo(r)), (int64_t) range_lo(r + 1) - 1);
+  }
+};
+
+// distribute num_edges among the cells in proportion to their weights. Cells that cannot
+// hold their share are filled and the excess is distributed among the others.
+void apportion(const CellModel &model, edge_id_t num_edges, std::vector<Cell> &cells) {
+  std::vector<double> weights(cells.size());
+  for (size_t i = 0; i < cells.size(); i++) weights[i] = model.weight(cells[i].row, cells[i].col);
+  std::vector<double> remainders(cells.size());
+  for (auto &cell : cells) cell.num_edges = 0;
+
+  edge_id_t remaining = num_edges;
+  while (remaining > 0) {
+    std::vector<size_t> open;
+    double total = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+      if (cells[i].num_edges < cells[i].capacity) {
+        open.push_back(i);
+        total += weights[i];
+      }
+    }
+    if (open.empty()) return;
+    // cells the model gives no weight still receive edges if nothing else can hold them
+    bool by_capacity = total <= 0;
+    if (by_capacity) {
+      for (size_t i : open) total += cells[i].capacity - cells[i].num_edges;
+    }
+
+    // largest remainder method so the shares sum to exactly remaining
+    edge_id_t assigned = 0;
+    std::vector<edge_id_t> share(cells.size(), 0);
+    for (size_t i : open) {
+      double w = by_capacity ? cells[i].capacity - cells[i].num_edges : weights[i];
+      double exact = remaining * (w / total);
+      share[i] = (edge_id_t) exact;
+      remainders[i] = exact - share[i];
+      assigned += share[i];
+    }
+    std::stable_sort(open.begin(), open.end(),
+                     [&](size_t a, size_t b) { return remainders[a] > remainders[b]; });
+    for (size_t j = 0; assigned < remaining; j = (j + 1) % open.size(), assigned++)
+      share[open[j]]++;
+
+    remaining = 0;
+    for (size_t i : open) {
+      edge_id_t room = cells[i].capacity - cells[i].num_edges;
+      cells[i].num_edges += std::min(share[i], room);
+      remaining += share[i] - std::min(share[i], room);
+    }
+  }
+}
+
+// choose the division of the matrix into cells so the largest cell fits in max_shard_edges.
+// Independent of the number of threads so that every thread count writes the same stream.
+uint32_t choose_cells(const StreamGenSettings &s, std::vector<Cell> &cells) {
+  uint32_t num_ranges = 1;
+  while (true) {
+    CellModel model(s, num_ranges);
+    cells.clear();
+    for (uint32_t row = 0; row < num_ranges; row++)
+      for (uint32_t col = row; col < num_ranges; col++)
+        cells.push_back({row, col, model.capacity(row, col), 0});
+    apportion(model, s.num_edges, cells);
+
+    edge_id_t largest = 0;
+    for (auto &cell : cells) largest = std::max(largest, cell.num_edges);
+    bool fits = largest <= s.max_shard_edges && num_ranges >= min_ranges;
+    uint64_t next_cells = (uint64_t) num_ranges * 2 * (num_ranges * 2 + 1) / 2;
+    if (fits || num_ranges * 2 > s.num_nodes) return num_ranges;
+    if (next_cells > max_cells) {
+      if (largest > s.max_shard_edges)
+        std::cerr << "WARNING: the largest cell has " << largest << " edges, more than the "
+                  << s.max_shard_edges << " allowed by max_shard_edges, because the matrix "
+                  << "cannot be divided into more than " << max_cells << " cells" << std::endl;
+      return num_ranges;
+    }
+    num_ranges *= 2;
+  }
+}
+
+/*
+ * Generate the distinct edges of a cell in stream order. Sparse cells reject repeated
+ * samples while dense cells choose a random subset of all their pairs.
+ */
+void generate_cell(const CellModel &model, const Cell &cell, const CounterRng &rng,
+                   std::vector<uint64_t> &edges) {
+  edges.clear();
+  node_id_t row_lo = model.range_lo(cell.row);
+  node_id_t col_lo = model.range_lo(cell.col);
+  node_id_t rows = model.range_size(cell.row);
+  node_id_t cols = model.range_size(cell.col);
+
+  if (cell.num_edges * 2 > cell.capacity) {
+    for (node_id_t i = 0; i < rows; i++)
+      for (node_id_t j = cell.row == cell.col ? i + 1 : 0; j < cols; j++)
+        edges.push_back(edge_key(row_lo + i, col_lo + j));
+    for (size_t i = 0; i < cell.num_edges; i++)
+      std::swap(edges[i], edges[i + rng.bounded(i, edges.size() - i)]);
+    edges.resize(cell.num_edges);
+    return;
+  }
+
+  std::unordered_set<uint64_t> present;
+  present.reserve(cell.num_edges);
+  // skewed cells may put most of their weight upon a few pairs so give up on sampling
+  // eventually and fill the rest of the cell by scanning its pairs from a random position
+  uint64_t max_draws = cell.num_edges * 32 + 1024;
+  for (uint64_t draw = 0; edges.size() < cell.num_edges && draw < max_draws; draw++) {
+    Edge e = model.sample(cell.row, cell.col, rng, draw);
+    if (e.src == e.dst) continue;
+    uint64_t key = edge_key(e.src, e.dst);
+    if (present.insert(key).second) edges.push_back(key);
+  }
+  uint64_t grid = (uint64_t) rows * cols;
+  uint64_t pos = rng.bounded(max_draws * draw_stride, grid);
+  while (edges.size() < cell.num_edges) {
+    node_id_t src = row_lo + pos / cols;
+    node_id_t dst = col_lo + pos % cols;
+    pos = (pos + 1) % grid;
+    if (src >= dst) continue;
+    uint64_t key = edge_key(src, dst);
+    if (present.insert(key).second) edges.push_back(key);
+  }
+}
+
+// the number of updates of a cell in phase p > 0 given its number in phase p - 1. Phase 0
+// inserts every edge of the cell and each later phase deletes or reinserts the first of them.
+inline edge_id_t phase_upds(const StreamGenSettings &s, size_t num_cells, size_t c, size_t p,
+                            edge_id_t prev) {
+  // randomized rounding keeps the expected churn of small cells correct
+  CounterRng rng(s.seed, num_cells + c);
+  return (edge_id_t) (prev * s.churn + rng.uniform(p - 1));
+}
+
+void write_all(int fd, const char *buf, size_t len, uint64_t off) {
+  while (len > 0) {
+    ssize_t ret = pwrite(fd, buf, len, off);
+    if (ret < 0) throw std::runtime_error("could not write stream: " + std::string(strerror(errno)));
+    buf += ret;
+    off += ret;
+    len -= ret;
+  }
+}
+
+} // namespace
+
+edge_id_t generate_binary_stream(const StreamGenSettings &s) {
+  uint64_t max_edges = (uint64_t) s.num_nodes * (s.num_nodes - 1) / 2;
+  if (s.num_nodes < 2 || s.num_edges > max_edges)
+    throw std::invalid_argument("num_edges exceeds the number of possible edges");
+  if (s.churn < 0 || s.churn >= 1)
+    throw std::invalid_argument("churn must be in [0, 1)");
+  if (s.model == RMAT && (s.num_nodes & (s.num_nodes - 1)) != 0)
+    throw std::invalid_argument("R-MAT requires the number of nodes to be a power of 2");
+  if (s.model == RMAT && (s.rmat_a < 0 || s.rmat_b < 0 || s.rmat_c < 0 ||
+                          s.rmat_a + s.rmat_b + s.rmat_c > 1))
+    throw std::invalid_argument("R-MAT probabilities must be non-negative and sum to at most 1");
+  if (s.model == POWER_LAW && s.power_law_exponent <= 2)
+    throw std::invalid_argument("the power law exponent must exceed 2");
+  if (s.compact && s.num_nodes > compact_type_bit)
+    throw std::invalid_argument("the compact format requires node ids to fit in 31 bits");
+
+  std::vector<Cell> cells;
+  uint32_t num_ranges = choose_cells(s, cells);
+  CellModel model(s, num_ranges);
+
+  // Cells are gathered into groups of consecutive cells. Within each phase the updates of
+  // the cells are laid out in cell order, and group_offs[p][g] is the position of the first
+  // update of group g within phase p. The positions within a phase are then mapped to the
+  // stream by shuffling its whole slots, so only one offset per group and phase is kept.
+  size_t group_cells = (cells.size() + max_groups - 1) / max_groups;
+  size_t num_groups  = (cells.size() + group_cells - 1) / group_cells;
+  std::vector<std::vector<uint64_t>> group_offs;
+  std::vector<uint64_t> phase_start; // position of the first update of each phase
+  std::vector<edge_id_t> upds(cells.size());
+  edge_id_t num_upds = 0;
+  for (size_t p = 0; p == 0 || s.churn > 0; p++) {
+    std::vector<uint64_t> offs(num_groups);
+    edge_id_t phase_total = 0;
+    for (size_t c = 0; c < cells.size(); c++) {
+      upds[c] = p == 0 ? cells[c].num_edges : phase_upds(s, cells.size(), c, p, upds[c]);
+      if (c % group_cells == 0) offs[c / group_cells] = phase_total;
+      phase_total += upds[c];
+    }
+    if (phase_total == 0 && p > 0) break;
+    group_offs.push_back(std::move(offs));
+    phase_start.push_back(num_upds);
+    num_upds += phase_total;
+  }
+  phase_start.push_back(num_upds);
+  std::vector<edge_id_t>().swap(upds);
+
+  // the whole slots of each phase are shuffled, a partial last slot stays at the end
+  std::vector<IndexPermutation> slot_perms;
+  for (size_t p = 0; p < group_offs.size(); p++) {
+    uint64_t full_slots = (phase_start[p + 1] - phase_start[p]) / slot_upds;
+    slot_perms.emplace_back(full_slots, CounterRng(s.seed, 2 * cells.size())(p));
+  }
+  auto stream_pos = [&](size_t p, uint64_t pos) {
+    uint64_t slot = pos / slot_upds;
+    if ((slot + 1) * slot_upds > phase_start[p + 1] - phase_start[p])
+      return phase_start[p] + pos;
+    return phase_start[p] + slot_perms[p](slot) * slot_upds + pos % slot_upds;
+  };
+
+  StreamHeader header;
+  header.format    = s.compact ? COMPACT_FORMAT : RAW_FORMAT;
+  header.num_nodes = s.num_nodes;
+  header.num_upds  = num_upds;
+  std::ostringstream header_out;
+  write_stream_header(header_out, header);
+  std::string header_data = header_out.str();
+  size_t upd_size = header.update_size();
+
+  int fd = open(s.out_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
+    throw std::runtime_error("could not open " + s.out_file + ": " + strerror(errno));
+  write_all(fd, header_data.data(), header_data.size(), 0);
+
+  std::atomic<size_t> next_group{0};
+  std::exception_ptr err = nullptr;
+  std::mutex err_lock;
+  auto task = [&]() {
+    std::vector<uint64_t> edges;
+    std::vector<uint64_t> offs(group_offs.size());
+    std::vector<char> buf((1 << 20) / upd_size * upd_size);
+    size_t batch = buf.size() / upd_size;
+    try {
+      for (size_t g = next_group++; g < num_groups; g = next_group++) {
+        for (size_t p = 0; p < group_offs.size(); p++) offs[p] = group_offs[p][g];
+        size_t end = std::min(cells.size(), (g + 1) * group_cells);
+        for (size_t c = g * group_cells; c < end; c++) {
+          generate_cell(model, cells[c], CounterRng(s.seed, c), edges);
+          edge_id_t num = cells[c].num_edges;
+          for (size_t p = 0; p < group_offs.size(); p++) {
+            if (p > 0) num = phase_upds(s, cells.size(), c, p, num);
+            uint8_t type = p % 2 == 0 ? INSERT : DELETE;
+            for (size_t i = 0; i < num; i += batch) {
+              size_t len = std::min(batch, (size_t) num - i);
+              for (size_t j = 0; j < len; j++) {
+                node_id_t src = edges[i + j] >> 32;
+                node_id_t dst = edges[i + j] & 0xFFFFFFFF;
+                if (s.compact) encode_compact_update(buf.data() + j * upd_size, type, src, dst);
+                else           encode_raw_update(buf.data() + j * upd_size, type, src, dst);
+              }
+              // write each piece of the batch that falls within a single slot
+              for (size_t j = 0; j < len;) {
+                uint64_t pos = offs[p] + i + j;
+                size_t piece = std::min(len - j, (size_t) (slot_upds - pos % slot_upds));
+                write_all(fd, buf.data() + j * upd_size, piece * upd_size,
+                          header_data.size() + stream_pos(p, pos) * upd_size);
+                j += piece;
+              }
+            }
+            offs[p] += num;
+          }
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lk(err_lock);
+      err = std::current_exception();
+      next_group = num_groups;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < std::max(s.num_threads, 1); t++) threads.emplace_back(task);
+  for (auto &thr : threads) thr.join();
+  close(fd);
+  if (err) std::rethrow_exception(err);
+  return num_upds;
+}
@@ -1,52 +1,94 @@
 #include "../../include/test/file_graph_verifier.h"
+#include "../../include/binary_graph_stream.h"
 
 #include <map>
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <memory>
 
-FileGraphVerifier::FileGraphVerifier(node_id_t n, const std::string &input_file) : sets(n) {
-  std::ifstream in(input_file);
+/*
+ * Read a cumulative graph file. Either text, "<num_nodes> <num_edges>" followed by a line
+ * "<src> <dst>" per edge, or a versioned binary stream of insertions as written by
+ * efficient_gen --binary. Unversioned (raw) binary streams cannot be told apart from text
+ * reliably so any other file whose header is not text is rejected.
+ * @param on_nodes  called with the number of nodes before any edge
+ * @param on_edge   called with the src and dst of each edge
+ */
+template <typename NodesFunc, typename EdgeFunc>
+static void read_cumul(const std::string &input_file, NodesFunc on_nodes, EdgeFunc on_edge) {
+  std::ifstream in(input_file, std::ios::binary);
   if (!in) {
     throw std::invalid_argument("FileGraphVerifier: Could not open: " + input_file);
   }
+  uint32_t marker = 0;
+  in.read((char *) &marker, sizeof(marker));
+  if (in && marker == stream_format_marker) {
+    in.close();
+    BinaryGraphStream stream(input_file, 1024 * 32);
+    on_nodes(stream.nodes());
+    for (edge_id_t e = 0; e < stream.edges(); e++) {
+      GraphUpdate upd = stream.get_edge();
+      on_edge(upd.edge.src, upd.edge.dst);
+    }
+    return;
+  }
 
-  kruskal_ref = kruskal(input_file);
-  node_id_t num_nodes;
+  // a text header is only digits and whitespace
+  char header[raw_header_size];
+  in.clear();
+  in.seekg(0);
+  in.read(header, raw_header_size);
+  for (std::streamsize i = 0; i < in.gcount(); i++) {
+    if (!std::isdigit((unsigned char) header[i]) && !std::isspace((unsigned char) header[i]))
+      throw std::invalid_argument("FileGraphVerifier: " + input_file + " is neither a text "
+                                  "graph nor a versioned binary stream");
+  }
+
+  in.clear();
+  in.seekg(0);
+  node_id_t n;
   edge_id_t m;
   node_id_t a, b;
-  in >> num_nodes >> m;
-  if (num_nodes != n) throw std::invalid_argument("num_nodes != n in FileGraphVerifier");
-
-  for (unsigned i = 0; i < n; ++i) {
-    boruvka_cc.push_back({i});
-    adj_matrix.emplace_back(n - i);
-  }
+  if (!(in >> n >> m))
+    throw std::invalid_argument("FileGraphVerifier: Could not parse header of: " + input_file);
+  on_nodes(n);
   while (m--) {
-    in >> a >> b;
+    if (!(in >> a >> b))
+      throw std::invalid_argument("FileGraphVerifier: Truncated graph file: " + input_file);
+    on_edge(a, b);
+  }
+}
+
+FileGraphVerifier::FileGraphVerifier(node_id_t n, const std::string &input_file) : sets(n) {
+  kruskal_ref = kruskal(input_file);
+  read_cumul(input_file, [&](node_id_t num_nodes) {
+    if (num_nodes != n) throw std::invalid_argument("num_nodes != n in FileGraphVerifier");
+    for (unsigned i = 0; i < n; ++i) {
+      boruvka_cc.push_back({i});
+      adj_matrix.emplace_back(n - i);
+    }
+  }, [&](node_id_t a, node_id_t b) {
     if (a > b) std::swap(a, b);
     b = b - a;
     adj_matrix[a][b] = !adj_matrix[a][b];
-  }
-  in.close();
+  });
 }
 
 std::vector<std::set<node_id_t>> FileGraphVerifier::kruskal(const std::string& input_file) {
-  std::ifstream in(input_file);
-  node_id_t n;
-  edge_id_t m;
-  in >> n >> m;
-  DisjointSetUnion<node_id_t> kruskal_sets(n);
-  int a,b;
-  while (m--) {
-    in >> a >> b;
-    kruskal_sets.merge(a,b);
-  }
-  in.close();
+  node_id_t n = 0;
+  std::unique_ptr<DisjointSetUnion<node_id_t>> kruskal_sets;
+  read_cumul(input_file, [&](node_id_t num_nodes) {
+    n = num_nodes;
+    kruskal_sets.reset(new DisjointSetUnion<node_id_t>(n));
+  }, [&](node_id_t a, node_id_t b) {
+    kruskal_sets->merge(a, b);
+  });
 
   std::map<node_id_t, std::set<node_id_t>> temp;
   for (unsigned i = 0; i < n; ++i) {
-    temp[kruskal_sets.find_root(i)].insert(i);
+    temp[kruskal_sets->find_root(i)].insert(i);
   }
 
   std::vector<std::set<node_id_t>> retval;
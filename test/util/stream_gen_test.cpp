@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+#include "../../include/test/stream_gen.h"
+#include "../../include/binary_graph_stream.h"
+
+// read the stream and check that it is valid: node ids are in range, there are no self
+// loops, and every update inserts an absent edge or deletes a present one
+static void check_stream(const std::string &file, const StreamGenSettings &settings,
+                         edge_id_t num_upds) {
+  BinaryGraphStream stream(file, 1024 * 32);
+  ASSERT_EQ(stream.nodes(), settings.num_nodes);
+  ASSERT_EQ(stream.edges(), num_upds);
+
+  std::unordered_set<uint64_t> present;
+  edge_id_t inserted = 0;
+  for (edge_id_t i = 0; i < num_upds; i++) {
+    GraphUpdate upd = stream.get_edge();
+    Edge e = upd.edge;
+    ASSERT_LT(e.src, settings.num_nodes);
+    ASSERT_LT(e.dst, settings.num_nodes);
+    ASSERT_NE(e.src, e.dst);
+    uint64_t key = (uint64_t) std::min(e.src, e.dst) << 32 | std::max(e.src, e.dst);
+    if (upd.type == INSERT) {
+      ASSERT_TRUE(present.insert(key).second) << "double insert at update " << i;
+      inserted += i < settings.num_edges;
+    } else {
+      ASSERT_EQ(upd.type, DELETE);
+      ASSERT_EQ(present.erase(key), 1u) << "delete before insert at update " << i;
+    }
+  }
+  // the stream begins by inserting every distinct edge
+  ASSERT_EQ(inserted, settings.num_edges);
+  if (settings.churn > 0) {
+    ASSERT_GT(num_upds, settings.num_edges);
+  }
+}
+
+TEST(StreamGenTestSuite, TestModelsProduceValidStreams) {
+  for (StreamGenModel model : {ERDOS_RENYI, RMAT, POWER_LAW}) {
+    StreamGenSettings settings;
+    settings.model       = model;
+    settings.num_nodes   = 1024;
+    settings.num_edges   = 20000;
+    settings.churn       = 0.3;
+    settings.seed        = 7;
+    settings.num_threads = 4;
+    settings.max_shard_edges = 512;
+    settings.out_file    = "./stream_gen.data";
+    edge_id_t num_upds = generate_binary_stream(settings);
+    check_stream(settings.out_file, settings, num_upds);
+    std::remove(settings.out_file.c_str());
+  }
+}
+
+TEST(StreamGenTestSuite, TestDenseAndCompact) {
+  StreamGenSettings settings;
+  settings.num_nodes   = 64;
+  settings.num_edges   = 64 * 63 / 2 - 10;
+  settings.churn       = 0.5;
+  settings.compact     = true;
+  settings.num_threads = 2;
+  settings.out_file    = "./stream_gen.data";
+  edge_id_t num_upds = generate_binary_stream(settings);
+  check_stream(settings.out_file, settings, num_upds);
+  std::remove(settings.out_file.c_str());
+
+  settings.num_edges = 64 * 63 / 2 + 1;
+  ASSERT_THROW(generate_binary_stream(settings), std::invalid_argument);
+}
+
+TEST(StreamGenTestSuite, TestIndependentOfThreads) {
+  StreamGenSettings settings;
+  settings.model     = RMAT;
+  settings.num_nodes = 1 << 12;
+  settings.num_edges = 50000;
+  settings.churn     = 0.2;
+  settings.max_shard_edges = 1000;
+
+  std::vector<std::string> contents;
+  for (int threads : {1, 4}) {
+    settings.num_threads = threads;
+    settings.out_file = "./stream_gen_" + std::to_string(threads) + ".data";
+    generate_binary_stream(settings);
+    std::ifstream in(settings.out_file, std::ios::binary);
+    contents.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    std::remove(settings.out_file.c_str());
+  }
+  ASSERT_EQ(contents[0], contents[1]);
+
+  // a different seed produces a different stream
+  settings.seed = 1;
+  generate_binary_stream(settings);
+  std::ifstream in(settings.out_file, std::ios::binary);
+  std::string other((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::remove(settings.out_file.c_str());
+  ASSERT_NE(contents[0], other);
+}
+
+TEST(StreamGenTestSuite, TestCellsInterleaved) {
+  StreamGenSettings settings;
+  settings.num_nodes   = 1 << 12;
+  settings.num_edges   = 50000;
+  settings.churn       = 0.5;
+  settings.num_threads = 2;
+  settings.max_shard_edges = 1000;
+  settings.out_file    = "./stream_gen.data";
+  generate_binary_stream(settings);
+
+  // the first updates of the insertion phase and of the deletion phase come from cells all
+  // over the adjacency matrix rather than only its first rows
+  BinaryGraphStream stream(settings.out_file, 1024 * 32);
+  const edge_id_t window = 4096;
+  for (edge_id_t phase_start : {(edge_id_t) 0, settings.num_edges}) {
+    node_id_t max_src = 0;
+    for (edge_id_t i = 0; i < window; i++) max_src = std::max(max_src, stream.get_edge().edge.src);
+    ASSERT_GT(max_src, settings.num_nodes / 2) << "phase starting at update " << phase_start;
+    for (edge_id_t i = window; i < settings.num_edges && phase_start == 0; i++) stream.get_edge();
+  }
+  std::remove(settings.out_file.c_str());
+}
+
+TEST(StreamGenTestSuite, TestWarnsWhenShardsDoNotFit) {
+  // the cells cannot be made small enough within the bound upon the number of cells
+  StreamGenSettings settings;
+  settings.num_nodes   = 1 << 12;
+  settings.num_edges   = 100000;
+  settings.num_threads = 2;
+  settings.max_shard_edges = 0;
+  settings.out_file    = "./stream_gen.data";
+  testing::internal::CaptureStderr();
+  edge_id_t num_upds = generate_binary_stream(settings);
+  std::string err = testing::internal::GetCapturedStderr();
+  ASSERT_NE(err.find("WARNING"), std::string::npos);
+  check_stream(settings.out_file, settings, num_upds);
+  std::remove(settings.out_file.c_str());
+}
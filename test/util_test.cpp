@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <map>
 #include "../include/util.h"
+#include "../include/batch_stats.h"
 
 TEST(UtilTestSuite, TestConcatPairingFn) {
   Edge exp;
@@ -13,3 +15,49 @@ TEST(UtilTestSuite, TestConcatPairingFn) {
     }
   }
 }
+
+TEST(UtilTestSuite, TestBatchSizeHistogram) {
+  BatchSizeHistogram hist;
+  ASSERT_EQ(hist.percentile(0.5), 0);
+  for (uint64_t size = 1; size <= 100; size++) hist.record(size);
+  ASSERT_EQ(hist.total(), 100);
+  ASSERT_EQ(hist.count(0), 1);  // [1, 2)
+  ASSERT_EQ(hist.count(6), 37); // [64, 128)
+  ASSERT_EQ(hist.percentile(0.5), 64);
+  ASSERT_EQ(hist.percentile(1), 128);
+  hist.record(1ull << 40);
+  ASSERT_EQ(hist.count(BatchSizeHistogram::num_buckets - 1), 1);
+}
+
+TEST(UtilTestSuite, TestHeavyHitters) {
+  // a few hot nodes within a long tail of nodes receiving one update each
+  size_t capacity = 16;  // far fewer counters than nodes
+  HeavyHitters left(capacity), right(capacity);
+  std::map<node_id_t, uint64_t> left_truth, right_truth;
+  for (node_id_t i = 0; i < 10000; i++) {
+    (i % 2 ? left : right).record(1000000 + i, 1);
+    if (i % 10 == 0) {
+      bool to_left = (i / 10) % 2;
+      (to_left ? left : right).record(i % 30, 25);
+      (to_left ? left_truth : right_truth)[i % 30] += 25;
+    }
+  }
+
+  // every node with more than total / capacity updates is tracked with bounded error
+  auto check = [](const HeavyHitters &summary, std::map<node_id_t, uint64_t> &truth) {
+    auto top = summary.top(3);
+    ASSERT_EQ(top.size(), 3);
+    for (auto &hh : top) {
+      ASSERT_EQ(truth.count(hh.node), 1);
+      ASSERT_LE(hh.count - hh.error, truth[hh.node]);
+      ASSERT_GE(hh.count, truth[hh.node]);
+    }
+  };
+  check(left, left_truth);
+  check(right, right_truth);
+
+  left.merge(right);
+  ASSERT_EQ(left.total_weight(), 10000 + 25 * 1000);
+  for (auto &kv : right_truth) left_truth[kv.first] += kv.second;
+  check(left, left_truth);
+}
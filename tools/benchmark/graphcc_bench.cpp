@@ -3,9 +3,13 @@
 #include <xxhash.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <random>
+#include <set>
 #include <thread>
 #include <vector>
 #include <sstream>
@@ -13,7 +17,9 @@
 #include "binary_graph_stream.h"
 #include "bucket.h"
 #include "dsu.h"
+#include "graph.h"
 #include "test/sketch_constructors.h"
+#include "test/stream_gen.h"
 
 constexpr uint64_t KB = 1024;
 constexpr uint64_t MB = KB * KB;
@@ -97,8 +103,247 @@ static void BM_MTFileIngest(benchmark::State& state) {
       benchmark::Counter(state.iterations() * num_edges, benchmark::Counter::kIsRate);
 }
 BENCHMARK(BM_MTFileIngest)->RangeMultiplier(4)->Range(1, 20)->UseRealTime();
+
+// Test the speed of reading all the data in the kron16 graph stream from a memory mapping
+static void BM_MMapFileIngest(benchmark::State& state) {
+  // determine the number of edges in the graph
+  uint64_t num_edges;
+  {
+    BinaryGraphStream_MT stream("/mnt/ssd2/binary_streams/kron_15_stream_binary", 1024);
+    num_edges = stream.edges();
+  }
+
+  // flush fs cache
+  flush_filesystem_cache();
+
+  // perform benchmark
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    threads.reserve(state.range(0));
+
+    MMapGraphStream stream("/mnt/ssd2/binary_streams/kron_15_stream_binary", 32 * 1024);
+
+    auto task = [&]() {
+      MMap_StreamReader reader(stream);
+      GraphUpdate upd;
+      do {
+        upd = reader.get_edge();
+      } while (upd.type != BREAKPOINT);
+    };
+
+    for (int i = 0; i < state.range(0); i++) threads.emplace_back(task);
+    for (int i = 0; i < state.range(0); i++) threads[i].join();
+  }
+  state.counters["Ingestion_Rate"] =
+      benchmark::Counter(state.iterations() * num_edges, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MMapFileIngest)->RangeMultiplier(4)->Range(1, 20)->UseRealTime();
+
+// Test the speed of reading all the data in the kron16 graph stream with several
+// asynchronous reads in flight per reader thread
+static void BM_AsyncFileIngest(benchmark::State& state) {
+  // determine the number of edges in the graph
+  uint64_t num_edges;
+  {
+    BinaryGraphStream_MT stream("/mnt/ssd2/binary_streams/kron_15_stream_binary", 1024);
+    num_edges = stream.edges();
+  }
+
+  // flush fs cache
+  flush_filesystem_cache();
+
+  // perform benchmark
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    threads.reserve(state.range(0));
+
+    AsyncGraphStream stream("/mnt/ssd2/binary_streams/kron_15_stream_binary", 32 * 1024,
+                            state.range(1), state.range(0));
+
+    auto task = [&]() {
+      Async_StreamReader reader(stream);
+      GraphUpdate upd;
+      do {
+        upd = reader.get_edge();
+      } while (upd.type != BREAKPOINT);
+    };
+
+    for (int i = 0; i < state.range(0); i++) threads.emplace_back(task);
+    for (int i = 0; i < state.range(0); i++) threads[i].join();
+  }
+  state.counters["Ingestion_Rate"] =
+      benchmark::Counter(state.iterations() * num_edges, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_AsyncFileIngest)->ArgsProduct({{1, 4, 16}, {1, 4, 16}})->UseRealTime();
 #endif  // FILE_INGEST_F
 
+// Generate a stream with 16 updates per node (plus 10% churn) and keep it in memory so that
+// benchmarks measure ingestion rather than file I/O. Streams are cached across benchmarks.
+static const std::vector<GraphUpdate>& bench_stream(node_id_t num_nodes, StreamGenModel model) {
+  static std::map<std::pair<node_id_t, int>, std::vector<GraphUpdate>> streams;
+  auto &upds = streams[{num_nodes, model}];
+  if (upds.empty()) {
+    StreamGenSettings settings;
+    settings.model       = model;
+    settings.num_nodes   = num_nodes;
+    settings.num_edges   = (edge_id_t) num_nodes * 16;
+    settings.churn       = 0.1;
+    settings.seed        = seed;
+    settings.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    settings.out_file    = "./bench_stream.data";
+    generate_binary_stream(settings);
+
+    BinaryGraphStream stream(settings.out_file, 32 * KB);
+    upds.resize(stream.edges());
+    stream.get_edges(upds.data(), upds.size());
+    std::remove(settings.out_file.c_str());
+  }
+  return upds;
+}
+
+// Test the end to end ingestion rate of the graph: updates are inserted into the guttering
+// system by the inserter threads and applied to the sketches by the GraphWorkers. Each
+// iteration is timed until the final flush has been applied, excluding the Boruvka query.
+// Args: num_nodes, stream model, num_groups, group_size, gutter system, num_inserters
+static void BM_Ingest(benchmark::State& state) {
+  node_id_t num_nodes = state.range(0);
+  auto &upds = bench_stream(num_nodes, (StreamGenModel) state.range(1));
+  auto config = GraphConfiguration()
+                    .num_groups(state.range(2))
+                    .group_size(state.range(3))
+                    .gutter_sys((GutterSystem) state.range(4));
+  int num_inserters = state.range(5);
+
+  uint64_t sketch_bytes = 0;
+  for (auto _ : state) {
+    Graph g{num_nodes, config, num_inserters};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_inserters; t++) {
+      threads.emplace_back([&](int thr_id) {
+        size_t begin = upds.size() * thr_id / num_inserters;
+        size_t end   = upds.size() * (thr_id + 1) / num_inserters;
+        for (size_t i = begin; i < end; i += 1024)
+          g.update_batch(upds.data() + i, std::min((size_t) 1024, end - i), thr_id);
+      }, t);
+    }
+    for (auto &thr : threads) thr.join();
+    g.connected_components(); // flushes before running Boruvka
+    state.SetIterationTime(std::chrono::duration<double>(g.flush_end - start).count());
+
+    // generating and applying a delta writes one supernode and reads and writes another
+    sketch_bytes += g.num_batches * 3 * Supernode::get_size();
+  }
+  state.counters["Update_Rate"] =
+      benchmark::Counter(state.iterations() * upds.size(), benchmark::Counter::kIsRate);
+  state.counters["Sketch_Bytes/Update"] = (double) sketch_bytes / (state.iterations() * upds.size());
+}
+BENCHMARK(BM_Ingest)
+    ->ArgNames({"nodes", "model", "groups", "group_size", "gutters", "inserters"})
+    // stream size and degree skew
+    ->ArgsProduct({{1 << 12, 1 << 14, 1 << 16}, {ERDOS_RENYI, RMAT, POWER_LAW}, {4}, {1},
+                   {STANDALONE}, {1}})
+    // GraphWorker configuration
+    ->ArgsProduct({{1 << 14}, {RMAT}, {1, 2, 4, 8}, {1, 2}, {STANDALONE}, {1}})
+    // guttering system and inserters
+    ->ArgsProduct({{1 << 14}, {RMAT}, {4}, {1}, {GUTTERTREE, STANDALONE, CACHETREE}, {1, 2, 4}})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+enum QueryGraphShape { SMALL_COMPONENTS, GIANT_COMPONENT, LONG_PATH };
+
+// Build the updates of a graph with a controlled component structure. The stream ends by
+// deleting and reinserting an edge of the spanning forest of every component so that the
+// eager DSU cannot answer queries and Boruvka recomputes every component.
+static std::vector<GraphUpdate> query_graph(node_id_t num_nodes, QueryGraphShape shape) {
+  constexpr node_id_t component_size = 8;
+  std::vector<GraphUpdate> upds;
+  std::vector<Edge> forest_edges;
+  std::mt19937_64 rng(seed);
+  switch (shape) {
+    case SMALL_COMPONENTS: // cliques of component_size nodes
+      for (node_id_t base = 0; base + 1 < num_nodes; base += component_size) {
+        node_id_t end = std::min(base + component_size, num_nodes);
+        for (node_id_t i = base; i < end; i++)
+          for (node_id_t j = i + 1; j < end; j++) upds.push_back({{i, j}, INSERT});
+        forest_edges.push_back({base, base + 1});
+      }
+      break;
+    case GIANT_COMPONENT: { // a random spanning tree plus 4 random edges per node
+      std::set<Edge> edges;
+      for (node_id_t i = 1; i < num_nodes; i++) edges.insert({(node_id_t) (rng() % i), i});
+      while (edges.size() < (size_t) num_nodes * 5) {
+        node_id_t a = rng() % num_nodes, b = rng() % num_nodes;
+        if (a != b) edges.insert({std::min(a, b), std::max(a, b)});
+      }
+      for (Edge e : edges) upds.push_back({e, INSERT});
+      std::shuffle(upds.begin(), upds.end(), rng);
+      forest_edges.push_back(upds[0].edge);
+      break;
+    }
+    case LONG_PATH:
+      for (node_id_t i = 0; i + 1 < num_nodes; i++) upds.push_back({{i, i + 1}, INSERT});
+      forest_edges.push_back({0, 1});
+      break;
+  }
+  for (Edge e : forest_edges) upds.push_back({e, DELETE});
+  for (Edge e : forest_edges) upds.push_back({e, INSERT});
+  return upds;
+}
+
+// Test the latency of queries upon graphs with different component structures. Each
+// iteration ingests the graph (untimed) and then times a single query. The counters break
+// the query down into the flush, Boruvka, backing up and restoring the sketches, and
+// constructing the result.
+// Args: num_nodes, graph shape, query (0 = connected_components(false),
+//       1 = connected_components(true), 2 = point_query), backup_in_mem
+static void BM_Query(benchmark::State& state) {
+  node_id_t num_nodes = state.range(0);
+  auto upds = query_graph(num_nodes, (QueryGraphShape) state.range(1));
+  int query = state.range(2);
+  auto config = GraphConfiguration().num_groups(4).backup_in_mem(state.range(3));
+
+  double flush = 0, boruvka = 0, backup = 0, restore = 0, result = 0, rounds = 0;
+  for (auto _ : state) {
+    Graph g{num_nodes, config};
+    g.update_batch(upds.data(), upds.size());
+
+    auto start = std::chrono::steady_clock::now();
+    if (query == 2)
+      benchmark::DoNotOptimize(g.point_query(0, num_nodes - 1));
+    else
+      benchmark::DoNotOptimize(g.connected_components(query == 1));
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    state.SetIterationTime(total.count());
+
+    const QueryStats &stats = g.query_stats;
+    double round_backup = 0;
+    for (auto &round : stats.rounds) round_backup += round.backup_time.count();
+    flush   += stats.flush_time.count();
+    backup  += round_backup;
+    restore += stats.restore_time.count();
+    boruvka += stats.alg_time.count() - round_backup - stats.restore_time.count();
+    result  += total.count() - stats.flush_time.count() - stats.alg_time.count();
+    rounds  += stats.rounds.size();
+  }
+  auto avg_ms = [&](double sec) {
+    return benchmark::Counter(sec * 1e3, benchmark::Counter::kAvgIterations);
+  };
+  state.counters["Flush_ms"]   = avg_ms(flush);
+  state.counters["Boruvka_ms"] = avg_ms(boruvka);
+  state.counters["Backup_ms"]  = avg_ms(backup);
+  state.counters["Restore_ms"] = avg_ms(restore);
+  state.counters["Result_ms"]  = avg_ms(result);
+  state.counters["Rounds"]     = benchmark::Counter(rounds, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Query)
+    ->ArgNames({"nodes", "shape", "query", "backup_in_mem"})
+    ->ArgsProduct({{1 << 14}, {SMALL_COMPONENTS, GIANT_COMPONENT, LONG_PATH}, {0, 1, 2}, {1}})
+    ->ArgsProduct({{1 << 14}, {GIANT_COMPONENT}, {1, 2}, {0}})
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
 static void BM_builtin_ffsll(benchmark::State& state) {
   size_t i = 0;
   size_t j = -1;
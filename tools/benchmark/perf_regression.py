@@ -0,0 +1,192 @@
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+'''
+Runs a fixed set of bench_cc benchmarks and compares them against a baseline.
+
+The baseline file lists the benchmarks to run. Each benchmark has a tolerance and a set of
+metrics, each with a baseline value and whether lower or higher is better. A metric
+regresses when it is worse than its baseline value by more than the tolerance (a fraction).
+Only the python standard library is used so that the harness runs offline.
+
+Exit status: 0 if no metric regressed, 1 if any regressed, 2 if the benchmarks could not
+be run, a benchmark in the baseline did not produce results, or the baseline was recorded
+upon a different machine.
+'''
+
+DEFAULT_TOLERANCE = 0.10
+
+# context keys that must match between the baseline and the run for values to be comparable
+MACHINE_CONTEXT = ('host_name', 'num_cpus')
+
+'''
+Run bench_cc upon the benchmarks and return its parsed json output
+'''
+def run_benchmarks(bench_cc, names, repetitions, min_time):
+    bench_filter = '^(' + '|'.join(re.escape(name) for name in names) + ')$'
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        out_file = os.path.join(tmp_dir, 'bench.json')
+        cmd = [bench_cc, '--benchmark_filter=' + bench_filter,
+               '--benchmark_out=' + out_file, '--benchmark_out_format=json',
+               '--benchmark_repetitions={0}'.format(repetitions)]
+        if min_time is not None:
+            cmd.append('--benchmark_min_time={0}'.format(min_time))
+        # bench_cc writes its scratch files to the working directory
+        subprocess.run(cmd, cwd=tmp_dir, stdout=subprocess.DEVNULL, check=True)
+        with open(out_file) as f:
+            return json.load(f)
+
+'''
+Collect the metrics of each benchmark from the json output. With several repetitions the
+median is used, otherwise the single run.
+'''
+def collect_results(output):
+    results = {}
+    for run in output['benchmarks']:
+        name = run.get('run_name', run['name'])
+        if run.get('run_type') == 'aggregate' and run.get('aggregate_name') != 'median':
+            continue
+        if run.get('run_type') == 'iteration' and name in results:
+            continue  # repeated runs are summarized by the median aggregate
+        metrics = {}
+        for key, val in run.items():
+            if key in ('real_time', 'cpu_time') or (isinstance(val, (int, float)) and
+                                                    not isinstance(val, bool) and
+                                                    key not in NON_METRICS):
+                metrics[key] = float(val)
+        results[name] = metrics
+    return results
+
+NON_METRICS = {'family_index', 'per_family_instance_index', 'repetitions', 'repetition_index',
+               'threads', 'iterations'}
+
+'''
+Direction of a metric that is not yet in the baseline
+'''
+def default_direction(metric):
+    if metric == 'real_time' or metric.endswith('_ms') or metric.endswith('Latency'):
+        return 'lower'
+    if 'Rate' in metric:
+        return 'higher'
+    return None  # not tracked by default
+
+'''
+Compare results against the baseline. Returns a list of report lines and whether any
+metric regressed.
+'''
+def compare(baseline, results):
+    lines = []
+    regressed = False
+    missing = False
+    for bench in baseline['benchmarks']:
+        name = bench['name']
+        tolerance = bench.get('tolerance', DEFAULT_TOLERANCE)
+        if name not in results:
+            lines.append('MISSING    {0}'.format(name))
+            missing = True
+            continue
+        for metric, base in sorted(bench['metrics'].items()):
+            if metric not in results[name]:
+                lines.append('MISSING    {0} {1}'.format(name, metric))
+                missing = True
+                continue
+            curr = results[name][metric]
+            expected = base['value']
+            if expected == 0:
+                continue
+            change = (curr - expected) / expected
+            worse = change > tolerance if base['better'] == 'lower' else change < -tolerance
+            status = 'REGRESSED' if worse else 'ok'
+            regressed |= worse
+            lines.append('{0:<10} {1} {2}: {3:.6g} vs baseline {4:.6g} ({5:+.1%}, tolerance {6:.0%})'
+                         .format(status, name, metric, curr, expected, change, tolerance))
+    return lines, regressed, missing
+
+'''
+Compare the machine the baseline was recorded upon against the context of this run. Returns
+a list of the mismatching context keys.
+'''
+def check_context(baseline, context):
+    base_context = baseline.get('context', {})
+    return ['{0}: baseline {1}, current {2}'.format(key, base_context.get(key), context.get(key))
+            for key in MACHINE_CONTEXT if base_context.get(key) != context.get(key)]
+
+'''
+Replace the values of the baseline with the results, keeping the tolerances and directions
+'''
+def update_baseline(baseline, results, context):
+    for bench in baseline['benchmarks']:
+        name = bench['name']
+        if name not in results:
+            print('WARNING: no results for', name)
+            continue
+        metrics = bench.setdefault('metrics', {})
+        for metric, val in results[name].items():
+            if metric in metrics:
+                metrics[metric]['value'] = val
+            elif default_direction(metric) is not None:
+                metrics[metric] = {'value': val, 'better': default_direction(metric)}
+    baseline['context'] = {key: context.get(key) for key in
+                           ('host_name', 'num_cpus', 'mhz_per_cpu', 'library_build_type', 'date')}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Check bench_cc against a performance baseline.')
+    parser.add_argument('bench_cc', type=str, help='path to the bench_cc executable')
+    parser.add_argument('baseline', type=str, help='the baseline json file')
+    parser.add_argument('--out', type=str, help='write the results of this run as json to this file')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='overwrite the baseline values with the results of this run')
+    parser.add_argument('--repetitions', type=int, default=None,
+                        help='repetitions of each benchmark. Defaults to the baseline setting')
+    parser.add_argument('--min-time', type=float, default=None,
+                        help='minimum seconds spent upon each benchmark')
+    parser.add_argument('--ignore-context', action='store_true',
+                        help='compare against a baseline recorded upon a different machine')
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    repetitions = args.repetitions or baseline.get('repetitions', 3)
+    names = [bench['name'] for bench in baseline['benchmarks']]
+
+    try:
+        output = run_benchmarks(os.path.abspath(args.bench_cc), names, repetitions, args.min_time)
+    except (OSError, subprocess.CalledProcessError) as err:
+        print('ERROR: could not run benchmarks:', err)
+        sys.exit(2)
+    results = collect_results(output)
+
+    if args.out:
+        with open(args.out, 'w') as f:
+            json.dump({'context': output['context'], 'results': results}, f, indent=2, sort_keys=True)
+
+    if args.update_baseline:
+        update_baseline(baseline, results, output['context'])
+        with open(args.baseline, 'w') as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write('\n')
+        print('Updated baseline', args.baseline)
+        sys.exit(0)
+
+    mismatches = check_context(baseline, output['context'])
+    if mismatches and not args.ignore_context:
+        print('ERROR: the baseline was recorded upon a different machine')
+        print('\n'.join('  ' + line for line in mismatches))
+        print('Rerun with --update-baseline to record a baseline for this machine, or with '
+              '--ignore-context to compare anyway')
+        sys.exit(2)
+
+    lines, regressed, missing = compare(baseline, results)
+    print('\n'.join(lines))
+    if missing:
+        print('ERROR: benchmarks or metrics of the baseline are missing from the results')
+        sys.exit(2)
+    if regressed:
+        print('Performance regression detected!')
+        sys.exit(1)
+    print('No performance regressions')
@@ -1,5 +1,7 @@
 #include <graph.h>
 #include <binary_graph_stream.h>
+#include <cstdio>
+#include <fstream>
 #include <thread>
 
 static bool shutdown = false;
@@ -47,11 +49,79 @@ void track_insertions(uint64_t total, Graph *g, std::chrono::steady_clock::time_
   return;
 }
 
+/*
+ * Function which is run in a seperate thread and periodically writes the
+ * ingestion metrics of the graph to a file until shutdown
+ * @param g           the graph object to query
+ * @param file        where to write the metrics
+ * @param prometheus  if true the file is replaced by each snapshot in the Prometheus text
+ *                    format, otherwise each snapshot is appended as a line of json
+ * @param interval    seconds between snapshots
+ */
+void dump_metrics(Graph *g, std::string file, bool prometheus, double interval) {
+  std::ofstream json_out;
+  if (!prometheus) json_out.open(file, std::ios::out | std::ios::trunc);
+
+  auto write_snapshot = [&]() {
+    IngestMetrics metrics = g->ingest_metrics();
+    if (!prometheus) {
+      metrics.write_json(json_out);
+      return;
+    }
+    // write then rename so that readers never see a partial file
+    std::string tmp_file = file + ".tmp";
+    {
+      std::ofstream out(tmp_file, std::ios::out | std::ios::trunc);
+      metrics.write_prometheus(out);
+    }
+    std::rename(tmp_file.c_str(), file.c_str());
+  };
+
+  auto next = std::chrono::steady_clock::now();
+  while (!shutdown) {
+    if (std::chrono::steady_clock::now() >= next) {
+      write_snapshot();
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(interval));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  write_snapshot();
+}
+
+static void usage() {
+  std::cout << "Arguments: stream_file, graph_workers, reader_threads, [--hw_counters] "
+               "[--metrics_file file] [--metrics_format json|prometheus] [--metrics_interval sec]"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
 int main(int argc, char **argv) {
-  if (argc != 4) {
+  if (argc < 4) {
     std::cout << "ERROR: Incorrect number of arguments!" << std::endl;
-    std::cout << "Arguments: stream_file, graph_workers, reader_threads" << std::endl;
-    exit(EXIT_FAILURE);
+    usage();
+  }
+  bool hw_counters = false;
+  std::string metrics_file;
+  bool prometheus = false;
+  double metrics_interval = 1;
+  for (int i = 4; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--hw_counters")
+      hw_counters = true;
+    else if (arg == "--metrics_file" && i + 1 < argc)
+      metrics_file = argv[++i];
+    else if (arg == "--metrics_format" && i + 1 < argc) {
+      std::string format = argv[++i];
+      if (format != "json" && format != "prometheus") usage();
+      prometheus = format == "prometheus";
+    }
+    else if (arg == "--metrics_interval" && i + 1 < argc)
+      metrics_interval = std::stod(argv[++i]);
+    else {
+      std::cout << "ERROR: Did not recognize argument: " << arg << std::endl;
+      usage();
+    }
   }
 
   shutdown = false;
@@ -63,7 +133,7 @@ int main(int argc, char **argv) {
   }
   int reader_threads = std::atoi(argv[3]);
 
-  BinaryGraphStream_MT stream(stream_file, 1024*32);
+  AsyncGraphStream stream(stream_file, 1024*32);
   node_id_t num_nodes = stream.nodes();
   size_t num_updates  = stream.edges();
   std::cout << "Processing stream: " << stream_file << std::endl;
@@ -71,23 +141,26 @@ int main(int argc, char **argv) {
   std::cout << "num_updates = " << num_updates << std::endl;
   std::cout << std::endl;
 
-  auto config = GraphConfiguration().gutter_sys(STANDALONE).num_groups(num_threads);
+  auto config = GraphConfiguration().gutter_sys(STANDALONE).num_groups(num_threads)
+                                    .hw_counters(hw_counters);
   config.gutter_conf().gutter_factor(-4);
   Graph g{num_nodes, config, reader_threads};
 
   auto ins_start = std::chrono::steady_clock::now();
   std::thread querier(track_insertions, num_updates, &g, ins_start);
+  std::thread metrics_dumper;
+  if (!metrics_file.empty())
+    metrics_dumper = std::thread(dump_metrics, &g, metrics_file, prometheus, metrics_interval);
 
   // Do the edge updates
   std::vector<std::thread> threads;
   threads.reserve(reader_threads);
   auto task = [&](const int thr_id) {
-    MT_StreamReader reader(stream);
-    GraphUpdate upd;
-    while(true) {
-      upd = reader.get_edge();
-      if (upd.type == BREAKPOINT) break;
-      g.update(upd, thr_id);
+    Async_StreamReader reader(stream);
+    std::vector<GraphUpdate> upds(1024);
+    size_t num_upds;
+    while((num_upds = reader.get_edges(upds.data(), upds.size())) > 0) {
+      g.update_batch(upds.data(), num_upds, thr_id);
     }
   };
 
@@ -109,6 +182,7 @@ int main(int argc, char **argv) {
 
   shutdown = true;
   querier.join();
+  if (metrics_dumper.joinable()) metrics_dumper.join();
 
   double num_seconds = insert_time.count();
   std::cout << "Total insertion time(sec):    " << num_seconds << std::endl;
@@ -117,4 +191,7 @@ int main(int argc, char **argv) {
   std::cout << "  Flush Gutters(sec):           " << flush_time.count() << std::endl;
   std::cout << "  Boruvka's Algorithm(sec):     " << cc_alg_time.count() << std::endl;
   std::cout << "Connected Components:         " << CC_num << std::endl;
+  std::cout << g.query_stats;
+  std::cout << g.worker_batch_stats();
+  if (hw_counters) std::cout << g.hw_counter_stats();
 }
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../include/test/stream_gen.h"
+
+static void usage() {
+  std::cout << "Arguments are: model num_nodes num_edges out_file [--churn r] [--seed s] "
+               "[--threads num] [--compact] [--rmat a b c] [--exponent e] [--shard_edges num]" << std::endl;
+  std::cout << "model:         One of 'er' (Erdos-Renyi), 'rmat' (R-MAT/Kronecker) or 'power_law'" << std::endl;
+  std::cout << "num_nodes:     The number of nodes. Must be a power of 2 for 'rmat'" << std::endl;
+  std::cout << "num_edges:     The number of distinct edges inserted by the stream" << std::endl;
+  std::cout << "out_file:      Where the binary stream will be written" << std::endl;
+  std::cout << "--churn:       Fraction of the edges that are deleted, of those that are reinserted, etc. Default 0" << std::endl;
+  std::cout << "--seed:        Seed of the random number generator. Default 0" << std::endl;
+  std::cout << "--threads:     The number of threads to generate with. Defaults to the number of cores" << std::endl;
+  std::cout << "--compact:     If present then the binary stream is written with 8 byte updates" << std::endl;
+  std::cout << "--rmat:        R-MAT quadrant probabilities. Default 0.57 0.19 0.19" << std::endl;
+  std::cout << "--exponent:    Exponent of the power law degree distribution. Default 2.5" << std::endl;
+  std::cout << "--shard_edges: Maximum edges generated at once by each thread. Default 2^22" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 5) usage();
+
+  StreamGenSettings settings;
+  std::string model = argv[1];
+  if (model == "er")             settings.model = ERDOS_RENYI;
+  else if (model == "rmat")      settings.model = RMAT;
+  else if (model == "power_law") settings.model = POWER_LAW;
+  else usage();
+  settings.num_nodes   = std::stoul(argv[2]);
+  settings.num_edges   = std::stoull(argv[3]);
+  settings.out_file    = argv[4];
+  settings.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (int i = 5; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--churn" && i + 1 < argc)
+      settings.churn = std::stod(argv[++i]);
+    else if (arg == "--seed" && i + 1 < argc)
+      settings.seed = std::stoull(argv[++i]);
+    else if (arg == "--threads" && i + 1 < argc)
+      settings.num_threads = std::max(std::atoi(argv[++i]), 1);
+    else if (arg == "--compact")
+      settings.compact = true;
+    else if (arg == "--rmat" && i + 3 < argc) {
+      settings.rmat_a = std::stod(argv[++i]);
+      settings.rmat_b = std::stod(argv[++i]);
+      settings.rmat_c = std::stod(argv[++i]);
+    }
+    else if (arg == "--exponent" && i + 1 < argc)
+      settings.power_law_exponent = std::stod(argv[++i]);
+    else if (arg == "--shard_edges" && i + 1 < argc)
+      settings.max_shard_edges = std::stoull(argv[++i]);
+    else {
+      std::cerr << "Did not recognize argument: " << arg << std::endl;
+      usage();
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  edge_id_t num_upds;
+  try {
+    num_upds = generate_binary_stream(settings);
+  } catch (std::exception &e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::chrono::duration<double> runtime = std::chrono::steady_clock::now() - start;
+  std::cout << "Wrote " << num_upds << " updates to " << settings.out_file << " in "
+            << runtime.count() << " seconds" << std::endl;
+}
@@ -1,98 +1,427 @@
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <graph_zeppelin_common.h>
+#include "../include/binary_stream_format.h"
 
-int main(int argc, char **argv) {
-  if (argc < 3 || argc > 5) {
-    std::cout << "Incorrect number of arguments. "
-                 "Expected [2-4] but got " << argc-1 << std::endl;
-    std::cout << "Arguments are: ascii_stream out_file_name [--update_type] [--verbose]" << std::endl;
-    std::cout << "ascii_stream:  The file to parse into binary format" << std::endl;
-    std::cout << "out_file_name: Where the binary stream will be written" << std::endl;
-    std::cout << "--update_type: If present then ascii stream indicates insertions vs deletions" << std::endl;
-    std::cout << "--silent:      If present then no warnings are printed when stream corrections are made" << std::endl;
-    exit(EXIT_FAILURE);
+// An update parsed from the ascii stream. Once corrected type holds the corrected update
+// type in its low bit and whether the correction changed the parsed type in bit 1.
+struct ParsedUpdate {
+  node_id_t src;
+  node_id_t dst;
+  uint8_t type;
+};
+static constexpr uint8_t corrected_bit = 2;
+
+// the ascii stream is converted one window of about this many bytes at a time so that
+// memory use does not grow with the length of the stream
+static constexpr size_t window_bytes = 1 << 25;
+
+// A piece of a window of the ascii stream that is parsed by one thread
+struct Chunk {
+  const char *begin;
+  const char *end;
+  std::vector<ParsedUpdate> upds;
+  std::vector<std::vector<uint32_t>> owned; // positions in upds of the updates each thread corrects
+  uint64_t first;                           // the index of upds[0] within the stream
+};
+
+/*
+ * The set of edges that are present in the stream so far, used to determine whether each
+ * update is an insertion or a deletion. An open addressing hash table with linear probing
+ * that grows and shrinks with the number of present edges, so memory is proportional to
+ * the edges present rather than to num_nodes^2 or to the number of updates.
+ */
+class EdgeParitySet {
+public:
+  // flip whether the edge is present. Returns true if it was present before the flip.
+  bool toggle(uint64_t edge) {
+    size_t slot = find(edge);
+    if (table[slot] == edge) {
+      erase(slot);
+      if (table.size() > min_size && num_present < table.size() / 8) resize(table.size() / 2);
+      return true;
+    }
+    table[slot] = edge;
+    if (++num_present > table.size() / 10 * 7) resize(table.size() * 2);
+    return false;
   }
 
-  std::ifstream txt_file(argv[1]);
-  if (!txt_file) {
-    std::cerr << "ERROR: could not open input file!" << std::endl;
-    exit(EXIT_FAILURE);
+private:
+  // no edge can be (2^32-1, 2^32-1) as node ids are less than num_nodes
+  static constexpr uint64_t empty = UINT64_MAX;
+  static constexpr size_t min_size = 1024;
+  std::vector<uint64_t> table = std::vector<uint64_t>(min_size, empty);
+  size_t num_present = 0;
+
+  inline size_t mask() const { return table.size() - 1; }
+  inline size_t home(uint64_t edge) const {
+    edge ^= edge >> 33;
+    edge *= 0xff51afd7ed558ccdULL;
+    edge ^= edge >> 33;
+    return edge & mask();
   }
-  std::ofstream out_file(argv[2], std::ios_base::binary | std::ios_base::out);
-  if (!out_file) {
-    std::cerr << "ERROR: could not open output file! " << argv[2] << ": " << strerror(errno) << std::endl;
-    exit(EXIT_FAILURE);
+
+  // the slot holding edge or the empty slot where it belongs
+  inline size_t find(uint64_t edge) const {
+    size_t slot = home(edge);
+    while (table[slot] != empty && table[slot] != edge) slot = (slot + 1) & mask();
+    return slot;
+  }
+
+  // empty a slot and shift back later entries of its probe sequence so lookups still work
+  void erase(size_t hole) {
+    table[hole] = empty;
+    --num_present;
+    for (size_t slot = (hole + 1) & mask(); table[slot] != empty; slot = (slot + 1) & mask()) {
+      size_t entry_home = home(table[slot]);
+      if (((slot - entry_home) & mask()) >= ((slot - hole) & mask())) {
+        table[hole] = table[slot];
+        table[slot] = empty;
+        hole = slot;
+      }
+    }
+  }
+
+  void resize(size_t size) {
+    std::vector<uint64_t> old_table(size, empty);
+    std::swap(table, old_table);
+    for (uint64_t edge : old_table)
+      if (edge != empty) table[find(edge)] = edge;
   }
+};
+
+static void usage(int argc) {
+  std::cout << "Incorrect number of arguments. "
+               "Expected [2-7] but got " << argc-1 << std::endl;
+  std::cout << "Arguments are: ascii_stream out_file_name [--update_type] [--silent] [--compress | --compact] [--threads num]" << std::endl;
+  std::cout << "ascii_stream:  The file to parse into binary format" << std::endl;
+  std::cout << "out_file_name: Where the binary stream will be written" << std::endl;
+  std::cout << "--update_type: If present then ascii stream indicates insertions vs deletions" << std::endl;
+  std::cout << "--silent:      If present then no warnings are printed when stream corrections are made" << std::endl;
+  std::cout << "--compress:    If present then the binary stream is written in the compressed format" << std::endl;
+  std::cout << "--compact:     If present then the binary stream is written with 8 byte updates" << std::endl;
+  std::cout << "--threads:     The number of threads to convert with. Defaults to the number of cores" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+static inline bool is_space(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+/*
+ * Parse an unsigned integer from the ascii stream
+ * @param pos  where to begin scanning. Leading whitespace is skipped
+ * @param end  the end of the ascii stream
+ * @param val  set to the parsed integer
+ * @return     the position after the integer or nullptr if there is no integer at pos
+ */
+static inline const char *scan_uint(const char *pos, const char *end, uint64_t &val) {
+  while (pos < end && is_space(*pos)) ++pos;
+  if (pos == end || *pos < '0' || *pos > '9') return nullptr;
+  val = 0;
+  while (pos < end && *pos >= '0' && *pos <= '9') val = val * 10 + (*pos++ - '0');
+  return pos;
+}
+
+// parse the updates in [begin, end) of the ascii stream. Each update is on its own line.
+static void parse_chunk(const char *begin, const char *end, const char *file_start,
+                        bool update_type, node_id_t num_nodes, std::vector<ParsedUpdate> &upds) {
+  const char *pos = begin;
+  while (true) {
+    while (pos < end && is_space(*pos)) ++pos;
+    if (pos == end) return;
+
+    const char *line = pos;
+    uint64_t u = 0, src = 0, dst = 0;
+    if (update_type) pos = scan_uint(pos, end, u);
+    if (pos != nullptr) pos = scan_uint(pos, end, src);
+    if (pos != nullptr) pos = scan_uint(pos, end, dst);
+    if (pos == nullptr || u > 1) {
+      std::cerr << "ERROR: could not parse update at byte " << line - file_start << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (src >= num_nodes || dst >= num_nodes) {
+      std::cerr << "ERROR: update " << u << " " << src << " " << dst
+                << " has a node id that is not less than the number of nodes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    upds.push_back({(node_id_t) src, (node_id_t) dst, (uint8_t) u});
+  }
+}
+
+// the newline ending the line that contains pos, or end
+static inline const char *line_end(const char *pos, const char *end) {
+  while (pos < end && *pos != '\n') ++pos;
+  return pos;
+}
+
+// write len bytes of buf to the output file at off
+static void write_all(int fd, const char *buf, size_t len, uint64_t off) {
+  while (len > 0) {
+    ssize_t ret = pwrite(fd, buf, len, off);
+    if (ret < 0) {
+      std::cerr << "ERROR: could not write output file: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    buf += ret;
+    off += ret;
+    len -= ret;
+  }
+}
+
+// run task(thr_id) upon num_threads threads
+template <typename Task>
+static void run_threads(size_t num_threads, Task task) {
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t t = 0; t < num_threads; t++) threads.emplace_back(task, t);
+  for (auto &thr : threads) thr.join();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) usage(argc);
 
   bool update_type = false;
   bool silent = false;
+  bool compress = false;
+  bool compact = false;
+  size_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
   for (int i = 3; i < argc; i++) {
     if (std::string(argv[i]) == "--update_type")
       update_type = true;
     else if (std::string(argv[i]) == "--silent") {
       silent = true;
     }
+    else if (std::string(argv[i]) == "--compress") {
+      compress = true;
+    }
+    else if (std::string(argv[i]) == "--compact") {
+      compact = true;
+    }
+    else if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+      num_threads = std::max(std::atoi(argv[++i]), 1);
+    }
     else {
-      std::cerr << "Did not recognize argument: " << argv[i] << " Expected '--update_type' or '--silent'";
+      std::cerr << "Did not recognize argument: " << argv[i] << " Expected '--update_type', '--silent', '--compress', '--compact', or '--threads num'";
       return EXIT_FAILURE;
     }
   }
+  if (compress && compact) {
+    std::cerr << "ERROR: --compress and --compact cannot be used together" << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  node_id_t num_nodes;
-  edge_id_t num_edges;
+  int txt_fd = open(argv[1], O_RDONLY);
+  struct stat txt_stat;
+  if (txt_fd == -1 || fstat(txt_fd, &txt_stat) == -1 || txt_stat.st_size == 0) {
+    std::cerr << "ERROR: could not open input file!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  int out_fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out_fd == -1) {
+    std::cerr << "ERROR: could not open output file! " << argv[2] << ": " << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  const char *txt_start = (const char *) mmap(nullptr, txt_stat.st_size, PROT_READ, MAP_PRIVATE,
+                                              txt_fd, 0);
+  if (txt_start == MAP_FAILED) {
+    std::cerr << "ERROR: could not map input file! " << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  const char *txt_end = txt_start + txt_stat.st_size;
+  madvise((void *) txt_start, txt_stat.st_size, MADV_SEQUENTIAL);
+
+  uint64_t header_nodes, header_edges;
+  const char *pos = scan_uint(txt_start, txt_end, header_nodes);
+  if (pos != nullptr) pos = scan_uint(pos, txt_end, header_edges);
+  if (pos == nullptr) {
+    std::cerr << "ERROR: could not parse ascii stream header!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  node_id_t num_nodes = header_nodes;
+  edge_id_t num_edges = header_edges;
 
-  txt_file >> num_nodes >> num_edges;
-  
   std::cout << "Parsed ascii stream header. . ." << std::endl;
   std::cout << "Number of nodes:   " << num_nodes << std::endl;
-  std::cout << "Number of updates: " << num_edges << std::endl; 
+  std::cout << "Number of updates: " << num_edges << std::endl;
   if (update_type)
     std::cout << "Assuming that update format is: upd_type src dst" << std::endl;
   else
     std::cout << "Assuming that update format is: src dst" << std::endl;
-  
+  if (compress)
+    std::cout << "Writing compressed binary stream" << std::endl;
+  if (compact)
+    std::cout << "Writing compact binary stream" << std::endl;
+
+  if (compact && num_nodes > compact_type_bit) {
+    std::cerr << "ERROR: the compact format requires node ids to fit in 31 bits" << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  out_file.write((char *) &num_nodes, sizeof(num_nodes));
-  out_file.write((char *) &num_edges, sizeof(num_edges));
+  // write the header. The updates follow it in the order they are converted.
+  StreamHeader header;
+  header.format     = compress ? COMPRESSED_FORMAT : (compact ? COMPACT_FORMAT : RAW_FORMAT);
+  header.num_nodes  = num_nodes;
+  header.num_upds   = num_edges;
+  header.block_upds = default_block_upds;
+  std::ostringstream header_out;
+  write_stream_header(header_out, header);
+  std::string header_data = header_out.str();
+  write_all(out_fd, header_data.data(), header_data.size(), 0);
+  size_t upd_size = header.update_size();
 
-  std::vector<std::vector<bool>> adj_mat(num_nodes);
-  for (node_id_t i = 0; i < num_nodes; ++i)
-    adj_mat[i] = std::vector<bool>(num_nodes - i);
+  size_t num_chunks = num_threads * 4;
+  std::vector<Chunk> chunks(num_chunks);
+  for (Chunk &chunk : chunks) chunk.owned.resize(num_threads);
+  // the edges present so far, split among the threads by the smaller endpoint of the edge
+  std::vector<EdgeParitySet> present(num_threads);
+  uint64_t converted = 0;             // updates of the stream converted so far
+  std::vector<ParsedUpdate> pending;  // updates that do not yet fill a compressed block
+  std::vector<std::vector<char>> blocks;
+  std::vector<uint64_t> block_offs(1, header_data.size());
+  const char *released = txt_start;   // the mapping before this has been released
 
-  bool u;
-  node_id_t src;
-  node_id_t dst;
+  for (const char *win_begin = pos; win_begin < txt_end && converted < num_edges;) {
+    const char *win_end = (size_t) (txt_end - win_begin) > window_bytes ?
+                          line_end(win_begin + window_bytes, txt_end) : txt_end;
 
-  while(num_edges--) {
-    u = false;
-    if (update_type)
-      txt_file >> u >> src >> dst;
-    else
-      txt_file >> src >> dst;
-
-    if (src > dst) {
-      if (!silent && u != adj_mat[dst][src - dst]) {
-        std::cout << "WARNING: update " << u << " " << src << " " << dst;
-        std::cout << " is double insert or delete before insert. Correcting." << std::endl;
+    // split the window into chunks that end at newlines and parse them in parallel
+    for (size_t c = 0; c < num_chunks; c++) {
+      chunks[c].begin = c == 0 ? win_begin : chunks[c - 1].end;
+      chunks[c].end   = c + 1 == num_chunks ? win_end :
+                        line_end(std::max(chunks[c].begin,
+                                 win_begin + (win_end - win_begin) * (c + 1) / num_chunks), win_end);
+    }
+    run_threads(num_threads, [&](size_t thr_id) {
+      for (size_t c = thr_id; c < num_chunks; c += num_threads) {
+        Chunk &chunk = chunks[c];
+        chunk.upds.clear();
+        parse_chunk(chunk.begin, chunk.end, txt_start, update_type, num_nodes, chunk.upds);
+        for (auto &owned : chunk.owned) owned.clear();
+        for (uint32_t i = 0; i < chunk.upds.size(); i++)
+          chunk.owned[std::min(chunk.upds[i].src, chunk.upds[i].dst) % num_threads].push_back(i);
       }
-      u = adj_mat[dst][src - dst];
-      adj_mat[dst][src - dst] = !adj_mat[dst][src - dst];
-    } else {
-      if (!silent && u != adj_mat[src][dst - src]) {
-        std::cout << "WARNING: update " << u << " " << src << " " << dst;
-        std::cout << " is double insert or delete before insert. Correcting." << std::endl;
+    });
+
+    // place the chunks within the stream. Updates past num_edges are ignored.
+    for (Chunk &chunk : chunks) {
+      chunk.first = converted;
+      chunk.upds.resize(std::min((uint64_t) chunk.upds.size(), num_edges - converted));
+      converted += chunk.upds.size();
+    }
+
+    // correct double inserts and deletes before inserts. An update's type only depends upon
+    // the earlier updates to its edge so each thread corrects the edges whose smaller
+    // endpoint it owns, in stream order, tracking which of them are present.
+    run_threads(num_threads, [&](size_t thr_id) {
+      for (Chunk &chunk : chunks) {
+        for (uint32_t i : chunk.owned[thr_id]) {
+          if (i >= chunk.upds.size()) break;
+          ParsedUpdate &upd = chunk.upds[i];
+          node_id_t lo = std::min(upd.src, upd.dst);
+          node_id_t hi = std::max(upd.src, upd.dst);
+          uint8_t u = present[thr_id].toggle((uint64_t) lo << 32 | hi);
+          upd.type = u | (u != upd.type ? corrected_bit : 0);
+        }
+      }
+    });
+
+    if (!silent) {
+      for (const Chunk &chunk : chunks) {
+        for (const ParsedUpdate &upd : chunk.upds) {
+          if (upd.type & corrected_bit) {
+            std::cout << "WARNING: update " << ((upd.type & 1) ^ 1) << " " << upd.src << " " << upd.dst;
+            std::cout << " is double insert or delete before insert. Correcting." << std::endl;
+          }
+        }
       }
-      u = adj_mat[src][dst - src];
-      adj_mat[src][dst - src] = !adj_mat[src][dst - src];
     }
 
-    out_file.write((char *) &u, sizeof(u));
-    out_file.write((char *) &src, sizeof(src));
-    out_file.write((char *) &dst, sizeof(dst));
+    if (!compress) {
+      // write each chunk at its offset within the file
+      size_t batch = (1 << 20) / upd_size;
+      run_threads(num_threads, [&](size_t thr_id) {
+        std::vector<char> buf(batch * upd_size);
+        for (size_t c = thr_id; c < num_chunks; c += num_threads) {
+          const Chunk &chunk = chunks[c];
+          for (size_t i = 0; i < chunk.upds.size(); i += batch) {
+            size_t num = std::min(batch, chunk.upds.size() - i);
+            for (size_t j = 0; j < num; j++) {
+              const ParsedUpdate &upd = chunk.upds[i + j];
+              if (compact)
+                encode_compact_update(buf.data() + j * upd_size, upd.type & 1, upd.src, upd.dst);
+              else
+                encode_raw_update(buf.data() + j * upd_size, upd.type & 1, upd.src, upd.dst);
+            }
+            write_all(out_fd, buf.data(), num * upd_size,
+                      header_data.size() + (chunk.first + i) * upd_size);
+          }
+        }
+      });
+    } else {
+      // compress the whole blocks of the window in parallel then place them one after another.
+      // The final block of the stream is written once every update has been converted.
+      for (const Chunk &chunk : chunks)
+        pending.insert(pending.end(), chunk.upds.begin(), chunk.upds.end());
+      uint64_t num_blocks = converted == num_edges ?
+          (pending.size() + header.block_upds - 1) / header.block_upds :
+          pending.size() / header.block_upds;
+      blocks.resize(num_blocks);
+      run_threads(num_threads, [&](size_t thr_id) {
+        std::vector<char> raw(header.block_upds * raw_update_size);
+        for (uint64_t b = thr_id; b < num_blocks; b += num_threads) {
+          size_t first = b * header.block_upds;
+          size_t num = std::min((size_t) header.block_upds, pending.size() - first);
+          for (size_t j = 0; j < num; j++) {
+            const ParsedUpdate &upd = pending[first + j];
+            encode_raw_update(raw.data() + j * raw_update_size, upd.type & 1, upd.src, upd.dst);
+          }
+          blocks[b].resize(sizeof(uint32_t) + max_compressed_size(num));
+          uint32_t payload_size = compress_block(raw.data(), num, blocks[b].data() + sizeof(uint32_t));
+          std::memcpy(blocks[b].data(), &payload_size, sizeof(payload_size));
+          blocks[b].resize(sizeof(uint32_t) + payload_size);
+        }
+      });
+
+      size_t first_block = block_offs.size() - 1;
+      for (uint64_t b = 0; b < num_blocks; b++)
+        block_offs.push_back(block_offs.back() + blocks[b].size());
+      run_threads(num_threads, [&](size_t thr_id) {
+        for (uint64_t b = thr_id; b < num_blocks; b += num_threads)
+          write_all(out_fd, blocks[b].data(), blocks[b].size(), block_offs[first_block + b]);
+      });
+      pending.erase(pending.begin(), pending.begin() +
+                    std::min(pending.size(), (size_t) (num_blocks * header.block_upds)));
+    }
+
+    // release the pages of the ascii stream that have been converted
+    const char *release_end = txt_start + (win_end - txt_start) / getpagesize() * getpagesize();
+    if (release_end > released) {
+      madvise((void *) released, release_end - released, MADV_DONTNEED);
+      released = release_end;
+    }
+    win_begin = win_end;
   }
-}
+  munmap((void *) txt_start, txt_stat.st_size);
+  close(txt_fd);
 
+  if (converted < num_edges) {
+    std::cerr << "ERROR: ascii stream contains " << converted << " updates but header "
+              << "states " << num_edges << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // the index of a compressed stream ends with its own offset
+  if (compress)
+    write_all(out_fd, (const char *) block_offs.data(), block_offs.size() * sizeof(uint64_t),
+              block_offs.back());
+  close(out_fd);
+}
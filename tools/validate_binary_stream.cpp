@@ -1,43 +1,181 @@
 #include <binary_graph_stream.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+/*
+ * HyperLogLog sketch for estimating the number of distinct edges in the stream.
+ * Each validation thread fills its own sketch and the sketches are merged at the end.
+ */
+class DistinctEdgeSketch {
+public:
+  inline void insert(Edge edge) {
+    uint64_t key = (uint64_t) std::min(edge.src, edge.dst) << 32 | std::max(edge.src, edge.dst);
+    uint64_t hash = XXH3_64bits(&key, sizeof(key));
+    size_t reg = hash >> (64 - precision);
+    uint8_t rank = __builtin_clzll((hash << precision) | (1ull << (precision - 1))) + 1;
+    registers[reg] = std::max(registers[reg], rank);
+  }
+
+  inline void merge(const DistinctEdgeSketch &oth) {
+    for (size_t i = 0; i < num_registers; i++)
+      registers[i] = std::max(registers[i], oth.registers[i]);
+  }
+
+  double estimate() const {
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t rank : registers) {
+      sum += std::ldexp(1.0, -rank);
+      zeros += rank == 0;
+    }
+    double m = num_registers;
+    double est = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (est <= 2.5 * m && zeros > 0) est = m * std::log(m / zeros); // linear counting
+    return est;
+  }
+
+private:
+  static constexpr size_t precision = 14;
+  static constexpr size_t num_registers = 1 << precision;
+  std::vector<uint8_t> registers = std::vector<uint8_t>(num_registers, 0);
+};
 
 int main(int argc, char **argv) {
-  if (argc != 2) {
+  if (argc != 2 && argc != 3) {
     std::cout << "Incorrect Number of Arguments!" << std::endl;
-    std::cout << "Arguments: stream_file" << std::endl;
+    std::cout << "Arguments: stream_file [num_threads]" << std::endl;
     exit(EXIT_FAILURE);
   }
-  
-  BinaryGraphStream stream(argv[1], 1024*1024);
+  int num_threads = argc == 3 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+  num_threads = std::max(num_threads, 1);
+
+  BinaryGraphStream_MT stream(argv[1], 1024*1024);
   node_id_t nodes = stream.nodes();
   size_t edges    = stream.edges();
 
+  std::string format = "raw";
+  if (stream.format() == COMPRESSED_FORMAT) format = "compressed";
+  if (stream.format() == COMPACT_FORMAT) format = "compact";
   std::cout << "Attempting to validate stream " << argv[1] << std::endl;
+  std::cout << "Stream format     = " << format << std::endl;
   std::cout << "Number of nodes   = " << nodes << std::endl;
   std::cout << "Number of updates = " << edges << std::endl;
+  std::cout << "Threads           = " << num_threads << std::endl;
   std::cout << ", , ,"  << std::endl;
 
+  // per node count of the updates upon its edges. Each update is inserted into the
+  // gutters of both of its endpoints so this is the load upon each node's gutter. This is
+  // not the degree as an edge that is inserted and deleted is counted twice. Each thread
+  // counts into its own array, spilling into node_upds when a count would overflow, and the
+  // arrays are merged at the end.
+  std::vector<std::vector<uint32_t>> thr_node_upds(num_threads, std::vector<uint32_t>(nodes, 0));
+  std::vector<std::atomic<uint64_t>> node_upds(nodes);
+  for (auto &count : node_upds) count = 0;
+  std::vector<DistinctEdgeSketch> sketches(num_threads);
+  std::atomic<uint64_t> num_read{0};
+  std::atomic<uint64_t> num_inserts{0};
+  std::atomic<bool> err{false};
+  std::mutex print_lock;
+
   // validate the src and dst of each node in the stream and ensure there are enough of them
-  bool err = false;
-  for (size_t e = 0; e < edges; e++) {
-    GraphUpdate upd;
-    try {
-      upd = stream.get_edge();
-    } catch (...) {
-      std::cerr << "ERROR: Could not get edge at index: " << e << std::endl;
-      err = true;
-      std::rethrow_exception(std::current_exception());
-      break;
-    }
-    Edge edge = upd.edge;
-    UpdateType u = upd.type;
-    if (edge.src >= nodes || edge.dst >= nodes || (u != INSERT && u != DELETE) || edge.src == edge.dst) {
-      std::cerr << "ERROR: edge idx:" << e << "=(" << edge.src << "," << edge.dst << "), " << u << std::endl;
-      err = true;
+  auto task = [&](int thr_id) {
+    MT_StreamReader reader(stream);
+    std::vector<uint32_t> &counts = thr_node_upds[thr_id];
+    auto count_update = [&](node_id_t node) {
+      if (++counts[node] == UINT32_MAX) {
+        node_upds[node].fetch_add(counts[node], std::memory_order_relaxed);
+        counts[node] = 0;
+      }
+    };
+    std::vector<GraphUpdate> upds(4096);
+    uint64_t inserts = 0;
+    size_t num;
+    while (true) {
+      try {
+        num = reader.get_edges(upds.data(), upds.size());
+      } catch (...) {
+        std::lock_guard<std::mutex> lk(print_lock);
+        std::cerr << "ERROR: Could not read a block of the stream. Is it truncated?" << std::endl;
+        err = true;
+        return;
+      }
+      if (num == 0) break;
+
+      for (size_t i = 0; i < num; i++) {
+        Edge edge = upds[i].edge;
+        UpdateType u = upds[i].type;
+        if (edge.src >= nodes || edge.dst >= nodes || (u != INSERT && u != DELETE) || edge.src == edge.dst) {
+          std::lock_guard<std::mutex> lk(print_lock);
+          std::cerr << "ERROR: edge=(" << edge.src << "," << edge.dst << "), " << u << std::endl;
+          err = true;
+          continue;
+        }
+        inserts += u == INSERT;
+        count_update(edge.src);
+        count_update(edge.dst);
+        sketches[thr_id].insert(edge);
+      }
+
+      uint64_t before = num_read.fetch_add(num);
+      if (before / 1000000000 != (before + num) / 1000000000) {
+        std::lock_guard<std::mutex> lk(print_lock);
+        std::cout << (before + num) / 1000000000 * 1000000000 << std::endl;
+      }
     }
-    if (e % 1000000000 == 0 && e != 0) std::cout << e << std::endl; 
+    num_inserts += inserts;
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) threads.emplace_back(task, t);
+  for (auto &thr : threads) thr.join();
+
+  if (num_read != edges) {
+    std::cerr << "ERROR: Read " << num_read << " updates but expected " << edges << std::endl;
+    err = true;
+  }
+
+  // statistics for planning ingestion
+  for (int t = 1; t < num_threads; t++) sketches[0].merge(sketches[t]);
+  std::vector<uint64_t> total_upds(nodes);
+  for (node_id_t i = 0; i < nodes; i++) total_upds[i] = node_upds[i];
+  for (auto &counts : thr_node_upds) {
+    for (node_id_t i = 0; i < nodes; i++) total_upds[i] += counts[i];
+    std::vector<uint32_t>().swap(counts);
   }
+  uint64_t num_deletes = num_read - num_inserts;
+  std::cout << "Stream statistics:" << std::endl;
+  std::cout << " Insertions        = " << num_inserts << std::endl;
+  std::cout << " Deletions         = " << num_deletes << std::endl;
+  if (num_deletes > 0)
+    std::cout << " Insert/delete     = " << (double) num_inserts / num_deletes << std::endl;
+  std::cout << " Distinct edges   ~= " << (uint64_t) sketches[0].estimate() << std::endl;
+
+  // histogram of the number of updates per node in power of two buckets
+  std::vector<uint64_t> histogram(65, 0);
+  for (uint64_t c : total_upds) {
+    histogram[c == 0 ? 0 : 64 - __builtin_clzll(c)]++;
+  }
+  std::cout << " Updates per node (updates: nodes)" << std::endl;
+  for (size_t b = 0; b < histogram.size(); b++) {
+    if (histogram[b] == 0) continue;
+    if (b == 0)
+      std::cout << "  0: " << histogram[b] << std::endl;
+    else
+      std::cout << "  [" << (1ull << (b - 1)) << ", " << (2ull << (b - 1)) - 1 << "]: "
+                << histogram[b] << std::endl;
+  }
+
+  // the nodes that receive the most updates
+  std::vector<node_id_t> hottest(nodes);
+  for (node_id_t i = 0; i < nodes; i++) hottest[i] = i;
+  size_t num_hottest = std::min((size_t) 10, (size_t) nodes);
+  std::partial_sort(hottest.begin(), hottest.begin() + num_hottest, hottest.end(),
+                    [&](node_id_t a, node_id_t b) { return total_upds[a] > total_upds[b]; });
+  std::cout << " Nodes with the most updates (node: updates)" << std::endl;
+  for (size_t i = 0; i < num_hottest; i++)
+    std::cout << "  " << hottest[i] << ": " << total_upds[hottest[i]] << std::endl;
 
   if (!err) std::cout << "Stream validated!" << std::endl;
   if (err) std::cout << "Stream invalid!" << std::endl;
 }
-